@@ -9,7 +9,7 @@
 #include <utmp.h>
 #include <getopt.h>
 
-#define MAX_SAMPLES 1024
+#define HISTORY_WINDOW 60   // rows kept for rendering; samples == 0 runs forever
 
 // Function declarations
 void printTopInfo(int samples, int tdelay, int sequential, int iteration);
@@ -61,10 +61,10 @@ int main(int argc, char *argv[]) {
     float cpuUsage = 0.0f, prevCpuUsage = 0.0f;
     int defaultBars = 3;
 
-    char memArr[MAX_SAMPLES][1024] = {0};
-    char cpuArr[MAX_SAMPLES][200] = {0};
+    static char memArr[HISTORY_WINDOW][1024];
+    static char cpuArr[HISTORY_WINDOW][200];
 
-    for (int i = 0; i < samples; i++) {
+    for (int i = 0; samples == 0 || i < samples; i++) {
         storeCpuStats(prevCpu);
         sleep(tdelay);
         printTopInfo(samples, tdelay, sequential, i);
@@ -113,6 +113,7 @@ void printTopInfo(int samples, int tdelay, int sequential, int iteration) {
 }
 
 void storeMemArr(char memArr[][1024], int i) {
+    i %= HISTORY_WINDOW;
     struct sysinfo info;
     sysinfo(&info);
 
@@ -129,14 +130,17 @@ void storeMemArr(char memArr[][1024], int i) {
 }
 
 void displayMemoryArray(int sequential, int samples, char memArr[][1024], int i) {
+    int window = (samples > 0 && samples < HISTORY_WINDOW) ? samples : HISTORY_WINDOW;
+    int first = i >= HISTORY_WINDOW ? i - HISTORY_WINDOW + 1 : 0;
+
     printf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot)\n");
     if (sequential) {
-        for (int k = 0; k < samples; k++) {
-            if (k == i) printf("%s\n", memArr[k]);
+        for (int k = 0; k < window; k++) {
+            if (k == i % window) printf("%s\n", memArr[i % HISTORY_WINDOW]);
             else printf("\n");
         }
     } else {
-        for (int j = 0; j <= i; j++) printf("%s\n", memArr[j]);
+        for (int j = first; j <= i; j++) printf("%s\n", memArr[j % HISTORY_WINDOW]);
     }
 }
 
@@ -153,8 +157,9 @@ void displayMemoryGraphics(double virtUsed, double *prevUsed, char memArr[][1024
     snprintf(info, sizeof(info), " %.2f (%.2f)", diff, virtUsed);
     strcat(line, info);
 
-    strncat(memArr[i], " ", 1);
-    strncat(memArr[i], line, sizeof(memArr[i]) - strlen(memArr[i]) - 1);
+    i %= HISTORY_WINDOW;
+    size_t used = strlen(memArr[i]);
+    snprintf(memArr[i] + used, sizeof(memArr[i]) - used, " %s", line);
     *prevUsed = virtUsed;
 }
 
@@ -204,8 +209,9 @@ void displayCpuGraphics(int sequential, char cpuArr[][200], int *barCount, float
     snprintf(percent, sizeof(percent), " %.2f%%", curUsage);
     strcat(line, percent);
 
-    strcpy(cpuArr[index], line);
-    for (int j = 0; j <= index; j++) printf("%s\n", cpuArr[j]);
+    strcpy(cpuArr[index % HISTORY_WINDOW], line);
+    for (int j = index >= HISTORY_WINDOW ? index - HISTORY_WINDOW + 1 : 0; j <= index; j++)
+        printf("%s\n", cpuArr[j % HISTORY_WINDOW]);
 
     *prevUsage = curUsage;
 }
@@ -0,0 +1,352 @@
+#define _GNU_SOURCE
+
+#include "alerts.h"
+#include <fcntl.h>
+#include <strings.h>
+#include <time.h>
+
+static const struct {
+    const char *name;
+    int metric, gbMetric;               // gbMetric is -1 when the value has no size form
+} metricNames[] = {
+    { "cpu", ALERT_CPU, -1 }, { "iowait", ALERT_IOWAIT, -1 }, { "steal", ALERT_STEAL, -1 },
+    { "irq", ALERT_IRQ, -1 }, { "mem", ALERT_MEM, ALERT_MEM_GB }, { "virt", ALERT_VIRT, ALERT_VIRT_GB },
+    { "MemAvailable", ALERT_AVAIL, ALERT_AVAIL_GB },
+};
+
+static const char *skipSpaces(const char *p) {
+    while (isspace((unsigned char)*p))
+        p++;
+    return p;
+}
+
+// Parses "[name:] metric|rate(metric) op value[%|GB|MB][/s] [for 30s | for 3 samples]" into the table
+int alertsAddRule(Alerts *alerts, const char *text) {
+    AlertRule rule;
+    char word[32];
+    const char *p = skipSpaces(text);
+    size_t len;
+    int found = -1, gb = 0;
+
+    if (alerts->count == MAX_ALERT_RULES)
+        return -1;
+    memset(&rule, 0, sizeof(AlertRule));
+    rule.forSamples = 1;
+
+    len = strcspn(p, ": \t");
+    if (p[len] == ':') {
+        if (len == 0 || len >= ALERT_NAME_LEN)
+            return -1;
+        memcpy(rule.name, p, len);
+        p = skipSpaces(p + len + 1);
+    }
+
+    len = strlen(p);
+    while (len > 0 && isspace((unsigned char)p[len - 1]))
+        len--;
+    if (len == 0 || len >= ALERT_TEXT_LEN)
+        return -1;
+    memcpy(rule.text, p, len);
+
+    // Metric, or rate(metric)
+    if (strncmp(p, "rate(", 5) == 0) {
+        rule.rate = 1;
+        p += 5;
+    }
+    len = strspn(p, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_");
+    if (len == 0 || len >= sizeof(word))
+        return -1;
+    memcpy(word, p, len);
+    word[len] = '\0';
+    p += len;
+    if (rule.rate && *p++ != ')')
+        return -1;
+    for (size_t i = 0; i < sizeof(metricNames) / sizeof(metricNames[0]); i++)
+        if (strcasecmp(word, metricNames[i].name) == 0)
+            found = i;
+    if (found == -1)
+        return -1;
+
+    // Comparison and threshold
+    p = skipSpaces(p);
+    if (*p != '>' && *p != '<')
+        return -1;
+    rule.op = *p == '>' ? (p[1] == '=' ? ALERT_GE : ALERT_GT) : (p[1] == '=' ? ALERT_LE : ALERT_LT);
+    p += p[1] == '=' ? 2 : 1;
+
+    char *end;
+    rule.threshold = strtod(p, &end);
+    if (end == p)
+        return -1;
+    p = end;
+    if (*p == '%')
+        p++;
+    else if (strncasecmp(p, "GB", 2) == 0 || strncasecmp(p, "MB", 2) == 0) {
+        if (toupper((unsigned char)*p) == 'M')
+            rule.threshold /= 1024.0;
+        gb = 1;
+        p += 2;
+    }
+    if (rule.rate && strncmp(p, "/s", 2) == 0)
+        p += 2;
+    if (gb && metricNames[found].gbMetric == -1)
+        return -1;
+    rule.metric = gb ? metricNames[found].gbMetric : metricNames[found].metric;
+    snprintf(rule.unit, sizeof(rule.unit), "%s%s", gb ? " GB" : "%", rule.rate ? "/s" : "");
+
+    // Optional hold: a duration or a number of consecutive samples
+    p = skipSpaces(p);
+    if (strncmp(p, "for", 3) == 0 && isspace((unsigned char)p[3])) {
+        p = skipSpaces(p + 3);
+        len = strcspn(p, " \t\r\n");
+        if (len == 0 || len >= sizeof(word))
+            return -1;
+        memcpy(word, p, len);
+        word[len] = '\0';
+        p = skipSpaces(p + len);
+
+        if (strncmp(p, "sample", 6) == 0) {
+            long samples = strtol(word, &end, 10);
+            if (*end || samples < 1)
+                return -1;
+            rule.forSamples = samples;
+            p += p[6] == 's' ? 7 : 6;
+            p = skipSpaces(p);
+        } else if (parseInterval(word, &rule.forNs) == -1)
+            return -1;
+    }
+    if (*p)
+        return -1;
+
+    alerts->rules[alerts->count++] = rule;
+    return 0;
+}
+
+// Compiles every rule of a config file ('#' starts a comment); prints the offending line on error
+int alertsLoad(Alerts *alerts, const char *path) {
+    char line[256];
+    int lineNumber = 0;
+    FILE *file = fopen(path, "r");
+
+    memset(alerts, 0, sizeof(Alerts));
+    alerts->logFd = STDOUT_FILENO;
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        line[strcspn(line, "#\n")] = '\0';
+        const char *rule = skipSpaces(line);
+        if (!*rule)
+            continue;
+
+        if (alerts->count == MAX_ALERT_RULES || alertsAddRule(alerts, rule) == -1) {
+            fprintf(stderr, "%s:%d: %s '%s'\n", path, lineNumber,
+                    alerts->count == MAX_ALERT_RULES ? "too many rules at" : "invalid rule", rule);
+            fclose(file);
+            return -1;
+        }
+    }
+    fclose(file);
+
+    if (alerts->count == 0) {
+        fprintf(stderr, "%s: no rules\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+extern char **environ;
+
+// Builds the hook environment once: the inherited one without ALERT_* entries, then
+// the four hookVars, which runHook rewrites for each event
+static int buildHookEnv(Alerts *alerts) {
+    size_t count = 0, n = 0;
+
+    while (environ[count])
+        count++;
+    alerts->hookEnv = malloc((count + 5) * sizeof(char *));
+    if (!alerts->hookEnv)
+        return -1;
+    for (size_t i = 0; i < count; i++)
+        if (strncmp(environ[i], "ALERT_", 6) != 0)
+            alerts->hookEnv[n++] = environ[i];
+    for (int v = 0; v < 4; v++)
+        alerts->hookEnv[n++] = alerts->hookVars[v];
+    alerts->hookEnv[n] = NULL;
+    return 0;
+}
+
+// Sends events to logPath (NULL or "-" for stdout) and runs hook, if given, on each of them
+int alertsOpenLog(Alerts *alerts, const char *logPath, const char *hook) {
+    alerts->hook = hook;
+    if (hook && buildHookEnv(alerts) == -1)
+        return -1;
+    if (!logPath || strcmp(logPath, "-") == 0)
+        return 0;
+    alerts->logFd = open(logPath, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    return alerts->logFd == -1 ? -1 : 0;
+}
+
+// Reaps the hooks that have exited, without waiting for the others
+static void reapHooks(Alerts *alerts) {
+    for (int i = 0; i < alerts->hookCount;) {
+        if (waitpid(alerts->hooks[i], NULL, WNOHANG) != 0)
+            alerts->hooks[i] = alerts->hooks[--alerts->hookCount];
+        else
+            i++;
+    }
+}
+
+// Runs the hook with the event in its environment. The environment is filled in before
+// fork(), since the child of a multithreaded process may only call async-signal-safe
+// functions; the hook is reaped later by reapHooks, never waited for
+static void runHook(Alerts *alerts, const AlertRule *rule, const char *state, const char *value) {
+    char (*vars)[ALERT_TEXT_LEN + 16] = alerts->hookVars;
+    char *argv[] = { "sh", "-c", (char *)alerts->hook, NULL };
+
+    reapHooks(alerts);
+    if (alerts->hookCount == MAX_ALERT_HOOKS)
+        return;
+
+    snprintf(vars[0], sizeof(vars[0]), "ALERT_STATE=%s", state);
+    snprintf(vars[1], sizeof(vars[1]), "ALERT_NAME=%s", rule->name);
+    snprintf(vars[2], sizeof(vars[2]), "ALERT_RULE=%s", rule->text);
+    snprintf(vars[3], sizeof(vars[3]), "ALERT_VALUE=%s", value);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        execve("/bin/sh", argv, alerts->hookEnv);
+        _exit(127);
+    }
+    if (pid > 0)
+        alerts->hooks[alerts->hookCount++] = pid;
+}
+
+// Writes one event line (a single write(), so concurrent appenders never interleave)
+static void emitEvent(Alerts *alerts, const AlertRule *rule, const char *state) {
+    char line[256], stamp[32], value[32];
+    time_t now = time(NULL);
+    struct tm local;
+
+    localtime_r(&now, &local);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &local);
+    snprintf(value, sizeof(value), "%.2f", rule->value);
+    int len = snprintf(line, sizeof(line), "%s %s %s%s%s (%s%s)\n", stamp, state, rule->name,
+                       rule->name[0] ? ": " : "", rule->text, value, rule->unit);
+    if (len >= (int)sizeof(line))
+        len = sizeof(line) - 1;
+
+    if (write(alerts->logFd, line, len) != len)
+        alerts->lostEvents++;   // a full disk must not stop the monitor
+    if (alerts->hook)
+        runHook(alerts, rule, state, value);
+    alerts->events++;
+}
+
+// Fills every metric of one sample; metrics the sample cannot provide are NAN
+static void alertMetrics(const MemSample *mem, const CpuSample *cpu, double *values) {
+    for (int m = 0; m < ALERT_METRICS; m++)
+        values[m] = NAN;
+
+    if (cpu && cpu->rows > 0) {
+        values[ALERT_CPU] = cpu->busy[0];
+        values[ALERT_IOWAIT] = cpu->iowait[0];
+        values[ALERT_STEAL] = cpu->steal[0];
+        values[ALERT_IRQ] = cpu->irq[0];
+    }
+    if (mem && mem->physTotalGb > 0) {
+        values[ALERT_MEM] = mem->physUsedGb / mem->physTotalGb * 100.0;
+        values[ALERT_MEM_GB] = mem->physUsedGb;
+        if (mem->virtTotalGb > 0)
+            values[ALERT_VIRT] = mem->virtUsedGb / mem->virtTotalGb * 100.0;
+        values[ALERT_VIRT_GB] = mem->virtUsedGb;
+        if (mem->detailed) {
+            values[ALERT_AVAIL] = mem->availGb / mem->physTotalGb * 100.0;
+            values[ALERT_AVAIL_GB] = mem->availGb;
+        }
+    }
+}
+
+// Evaluates every rule against one sample in a single pass; returns the number of events emitted
+int alertsEvaluate(Alerts *alerts, const MemSample *mem, const CpuSample *cpu) {
+    int emitted = 0;
+
+    if (alerts->hookCount > 0)
+        reapHooks(alerts);
+    if (alerts->count == 0 || (!mem && !cpu))
+        return 0;
+
+    uint64_t now = mem ? mem->header.timestampNs : cpu->header.timestampNs;
+    double seconds = alerts->prevNs && now > alerts->prevNs ? (now - alerts->prevNs) / 1e9 : 0.0;
+
+    alertMetrics(mem, cpu, alerts->values);
+    for (int m = 0; m < ALERT_METRICS; m++) {
+        alerts->rates[m] = seconds > 0 ? (alerts->values[m] - alerts->prev[m]) / seconds : NAN;
+        alerts->prev[m] = alerts->values[m];
+    }
+    alerts->prevNs = now;
+
+    for (int r = 0; r < alerts->count; r++) {
+        AlertRule *rule = &alerts->rules[r];
+        double value = rule->rate ? alerts->rates[rule->metric] : alerts->values[rule->metric];
+
+        if (isnan(value))
+            continue;   // not in this sample: the rule keeps its state
+        rule->value = value;
+
+        int holds;
+        switch (rule->op) {
+            case ALERT_GT: holds = value > rule->threshold; break;
+            case ALERT_GE: holds = value >= rule->threshold; break;
+            case ALERT_LT: holds = value < rule->threshold; break;
+            default: holds = value <= rule->threshold; break;
+        }
+
+        if (!holds) {
+            rule->held = 0;
+            if (rule->firing) {
+                rule->firing = 0;
+                alerts->firingCount--;
+                emitEvent(alerts, rule, "RESOLVED");
+                emitted++;
+            }
+            continue;
+        }
+
+        if (rule->held++ == 0)
+            rule->sinceNs = now;
+        if (!rule->firing && rule->held >= rule->forSamples && now - rule->sinceNs >= rule->forNs) {
+            rule->firing = 1;
+            alerts->firingCount++;
+            emitEvent(alerts, rule, "FIRING");
+            emitted++;
+        }
+    }
+    return emitted;
+}
+
+// Prints the rules currently firing
+void printAlerts(const Alerts *alerts) {
+    renderf("### Alerts ### (%d rules, %d firing", alerts->count, alerts->firingCount);
+    if (alerts->lostEvents > 0)
+        renderf(", %llu events not logged", (unsigned long long)alerts->lostEvents);
+    renderf(")\n");
+    for (int r = 0; r < alerts->count; r++) {
+        const AlertRule *rule = &alerts->rules[r];
+        if (rule->firing)
+            renderf(" FIRING %-20s %10.2f%-6s %s\n", rule->name[0] ? rule->name : "-", rule->value, rule->unit,
+                    rule->text);
+    }
+}
+
+// Closes the log; hooks still running are left to finish on their own
+void alertsClose(Alerts *alerts) {
+    reapHooks(alerts);
+    if (alerts->logFd > STDERR_FILENO)
+        close(alerts->logFd);
+    free(alerts->hookEnv);
+    alerts->hookEnv = NULL;
+}
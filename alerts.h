@@ -0,0 +1,61 @@
+#ifndef ALERTS_H
+#define ALERTS_H
+
+#include "stats_functions.h"
+
+#define MAX_ALERT_RULES 64
+#define ALERT_NAME_LEN 32
+#define ALERT_TEXT_LEN 96
+#define MAX_ALERT_HOOKS 16          // hook processes running at once; further events skip the hook
+
+// Values a rule can test, all computed once per sample; the _GB variants are absolute sizes
+enum {
+    ALERT_CPU, ALERT_IOWAIT, ALERT_STEAL, ALERT_IRQ,    // aggregate CPU row, %
+    ALERT_MEM, ALERT_VIRT, ALERT_AVAIL,                 // % of physical (virtual) total
+    ALERT_MEM_GB, ALERT_VIRT_GB, ALERT_AVAIL_GB,
+    ALERT_METRICS
+};
+
+enum { ALERT_GT, ALERT_GE, ALERT_LT, ALERT_LE };
+
+// One compiled rule and its evaluation state
+typedef struct {
+    char name[ALERT_NAME_LEN];          // optional "name:" prefix, empty when absent
+    char text[ALERT_TEXT_LEN];          // the condition as written
+    char unit[8];
+    int metric, op;
+    int rate;                           // test the change per second instead of the value
+    double threshold;
+    uint64_t forNs;                     // "for 30s": condition must hold this long
+    uint32_t forSamples;                // "for 3 samples": ... or this many samples in a row
+    int firing;
+    uint32_t held;                      // consecutive samples the condition held
+    uint64_t sinceNs;                   // timestamp of the first of them
+    double value;                       // last evaluated value
+} AlertRule;
+
+// Flat rule table plus the per-metric values and rates of the current sample
+typedef struct {
+    int count, firingCount;
+    AlertRule rules[MAX_ALERT_RULES];
+    double values[ALERT_METRICS], rates[ALERT_METRICS], prev[ALERT_METRICS];
+    uint64_t prevNs;
+    int logFd;                          // events go here (stdout by default)
+    const char *hook;                   // shell command run on every event, or NULL
+    char **hookEnv;                     // its environment, built once; ends in the hookVars
+    char hookVars[4][ALERT_TEXT_LEN + 16];
+    pid_t hooks[MAX_ALERT_HOOKS];       // hook processes not reaped yet
+    int hookCount;
+    uint64_t events;
+    uint64_t lostEvents;                // event lines the log did not take (e.g. a full disk)
+} Alerts;
+
+// Function prototypes
+int alertsAddRule(Alerts *alerts, const char *text);
+int alertsLoad(Alerts *alerts, const char *path);
+int alertsOpenLog(Alerts *alerts, const char *logPath, const char *hook);
+int alertsEvaluate(Alerts *alerts, const MemSample *mem, const CpuSample *cpu);
+void printAlerts(const Alerts *alerts);
+void alertsClose(Alerts *alerts);
+
+#endif // ALERTS_H
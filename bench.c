@@ -0,0 +1,438 @@
+#define _GNU_SOURCE
+
+#include "stats_functions.h"
+#include "rollup.h"
+#include "recorder.h"
+#include "fleet.h"
+#include "alerts.h"
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define BENCH_MIN_NS 200000000ull   // each benchmark runs for at least this long
+#define E2E_SAMPLES 50
+#define FLEET_AGENTS 1000
+
+// Counts heap allocations made by the code under test (glibc only)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long allocations;
+
+void *malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+typedef struct {
+    const char *name;
+    void (*setup)(void);
+    void (*op)(void);
+    void (*teardown)(void);
+} Bench;
+
+static CpuSnapshot snapshots[2];
+static CpuSample cpuSample;
+static MemSample memSample;
+static SessionTable sessions;
+static History history;
+static SampleRing *requestRing, *replyRing;
+static pid_t echoPID;
+static const CollectorOps *benchedOps;
+static Collector collector;
+static void *collectorSampleBuf;
+static Rollups rollups;
+static Alerts alerts;
+static uint64_t rollupTick;
+static ChunkCodec codec;
+static unsigned char *codecStream, *codecRecord;
+static FleetAggregator fleet;
+static int fleetTick, fleetAgents[FLEET_AGENTS];
+static char fleetPath[64];
+static struct {
+    FleetFrame frame;
+    FleetSample samples[FLEET_BATCH];
+} fleetBatch;
+
+// Opens the registered collector under test; the warm-up sample is its baseline
+static void setupCollector(void) {
+    if (collectorOpen(&collector, benchedOps->name) == -1 ||
+        !(collectorSampleBuf = calloc(1, benchedOps->sampleSize))) {
+        perror(benchedOps->name);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// One tick of a registered collector, exactly as both engines drive it
+static void benchCollector(void) {
+    collectorSample(&collector, collectorSampleBuf);
+}
+
+static void teardownCollector(void) {
+    collectorClose(&collector);
+    free(collectorSampleBuf);
+}
+
+// Computes the usage of two fixed snapshots: the delta kernel alone
+static void benchCpuKernel(void) {
+    calculateCpuUsage(&snapshots[0], &snapshots[1], &cpuSample);
+}
+
+// One utmp scan of the user collector (what storeUserInfoThird does per change)
+static void benchUsers(void) {
+    sampleUsers(&sessions);
+}
+
+// Formats one memory graphics line
+static void benchMemoryGraphics(void) {
+    char line[1024] = "0.93 GB / 5.87 GB  -- 0.93 GB / 5.87 GB";
+    memoryGraphics(0.93, 0.05, 0, line, sizeof(line));
+}
+
+// Three windows (10s, 1m, 5m) at a 1 ms interval: 300k samples in the longest
+static void setupRollup(void) {
+    uint64_t windowsNs[ROLLUP_MAX_WINDOWS];
+    int count = parseWindows(ROLLUP_DEFAULT_WINDOWS, windowsNs);
+
+    if (rollupInit(&rollups, windowsNs, count, 1000000) == -1) {
+        perror("Failed to allocate rollup windows");
+        exit(EXIT_FAILURE);
+    }
+    memSample.physTotalGb = 8.0;
+    cpuSample.rows = 1;
+}
+
+// Adds one varied sample to every window and refreshes the aggregates
+static void benchRollup(void) {
+    rollupTick++;
+    memSample.header.timestampNs = rollupTick * 1000000;
+    memSample.physUsedGb = 2.0 + (rollupTick % 13) * 0.1;
+    cpuSample.busy[0] = (float)(rollupTick * 37 % 100);
+    rollupPush(&rollups, &memSample, &cpuSample);
+}
+
+static void teardownRollup(void) {
+    rollupFree(&rollups);
+}
+
+// A full rule table of the kinds a config file holds; events (rare here) go to /dev/null
+static void setupAlerts(void) {
+    static const char *rules[] = {
+        "cpu > 90% for 3 samples", "MemAvailable < 5% for 30s", "rate(mem) > 2%/s", "virt >= 95%",
+        "iowait > 20% for 10s", "steal > 5%", "mem > 7.5GB for 5 samples", "rate(cpu) > 80%/s",
+    };
+
+    memset(&alerts, 0, sizeof(Alerts));
+    for (int i = 0; i < MAX_ALERT_RULES; i++)
+        alertsAddRule(&alerts, rules[i % (sizeof(rules) / sizeof(rules[0]))]);
+    if (alertsOpenLog(&alerts, "/dev/null", NULL) == -1) {
+        perror("Failed to open /dev/null");
+        exit(EXIT_FAILURE);
+    }
+    memSample.physTotalGb = memSample.virtTotalGb = 8.0;
+    memSample.detailed = 1;
+    cpuSample.rows = 1;
+}
+
+// Evaluates every rule against one varied sample
+static void benchAlerts(void) {
+    rollupTick++;
+    memSample.header.timestampNs = rollupTick * 1000000000ull;
+    memSample.physUsedGb = memSample.virtUsedGb = 2.0 + (rollupTick % 13) * 0.1;
+    memSample.availGb = 8.0 - memSample.physUsedGb;
+    cpuSample.busy[0] = (float)(rollupTick * 37 % 100);
+    alertsEvaluate(&alerts, &memSample, &cpuSample);
+}
+
+static void teardownAlerts(void) {
+    alertsClose(&alerts);
+}
+
+// A 64-core record, compressed the way --record --compress does it
+static void setupCodec(void) {
+    uint32_t recordSize = (sizeof(RecordSample) + 65 * sizeof(float) + 7) & ~7u;
+
+    if (codecInit(&codec, recordSize, 100000000) == -1 ||
+        !(codecStream = calloc(CODEC_CHUNK_RECORDS, codecMaxRecordBytes(&codec))) ||
+        !(codecRecord = calloc(1, recordSize))) {
+        perror("Failed to allocate codec buffers");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Encodes one record with a jittered timestamp and a few moving cores
+static void benchCodec(void) {
+    RecordSample *record = (RecordSample *)codecRecord;
+
+    if (codec.records == CODEC_CHUNK_RECORDS) {
+        memset(codecStream, 0, (codec.bits + 7) / 8);
+        codecReset(&codec);
+    }
+    rollupTick++;
+    record->timestampNs = rollupTick * 100000000 + rollupTick * 7919 % 50000;
+    record->tick = (uint32_t)rollupTick;
+    record->physUsedGb = 2.0f + (rollupTick % 5) * 0.001f;
+    for (int i = 0; i < 65; i += 8)
+        record->cpuBusy[i] = (float)(rollupTick * (i + 37) % 10000) / 100.0f;
+    codecEncode(&codec, codecStream, codecRecord);
+}
+
+static void teardownCodec(void) {
+    codecFree(&codec);
+    free(codecStream);
+    free(codecRecord);
+}
+
+// An aggregator on a Unix socket with FLEET_AGENTS connected agents; an eventfd stands in for the render timer
+static void setupFleet(void) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    FleetFrame frame = { FLEET_MAGIC, FLEET_VERSION, FLEET_HELLO, 1, sizeof(FleetHello) };
+    struct {
+        FleetFrame frame;
+        FleetHello hello;
+    } hello = { frame, { "", 100000000, 1, 0 } };
+
+    snprintf(fleetPath, sizeof(fleetPath), "/tmp/sysstats_bench_%d.sock", (int)getpid());
+    fleetTick = eventfd(0, EFD_CLOEXEC);
+    if (fleetTick == -1 || fleetAggregatorOpen(&fleet, fleetPath, fleetTick) == -1) {
+        perror("Failed to open aggregator socket");
+        exit(EXIT_FAILURE);
+    }
+
+    strcpy(addr.sun_path, fleetPath);
+    for (int i = 0; i < FLEET_AGENTS; i++) {
+        snprintf(hello.hello.name, sizeof(hello.hello.name), "agent%d", i);
+        fleetAgents[i] = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fleetAgents[i] == -1 || connect(fleetAgents[i], (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+            write(fleetAgents[i], &hello, sizeof(hello)) != sizeof(hello)) {
+            perror("Failed to connect bench agent");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    fleetBatch.frame = (FleetFrame){ FLEET_MAGIC, FLEET_VERSION, FLEET_SAMPLES, FLEET_BATCH,
+                                     FLEET_BATCH * sizeof(FleetSample) };
+    for (int i = 0; i < FLEET_BATCH; i++)
+        fleetBatch.samples[i] = (FleetSample){ .physUsedGb = 1.0f, .physTotalGb = 8.0f, .cpuBusy = (float)i };
+}
+
+// Every agent sends one full batch, then the aggregator drains them up to the next tick
+static void benchFleet(void) {
+    uint64_t one = 1;
+
+    for (int i = 0; i < FLEET_AGENTS; i++)
+        if (write(fleetAgents[i], &fleetBatch, sizeof(fleetBatch)) != sizeof(fleetBatch))
+            perror("Bench agent write failed");
+    if (write(fleetTick, &one, sizeof(one)) != sizeof(one))
+        perror("eventfd write failed");
+    fleetAggregatorServe(&fleet);
+}
+
+static void teardownFleet(void) {
+    for (int i = 0; i < FLEET_AGENTS; i++)
+        close(fleetAgents[i]);
+    fleetAggregatorClose(&fleet);
+    close(fleetTick);
+}
+
+// Fills the history window with varied samples
+static void setupHistory(void) {
+    historyInit(&history, 0);
+    for (int i = 0; i < HISTORY_WINDOW; i++) {
+        memSample.virtUsedGb = 1.0 + (i % 7) * 0.01;
+        cpuSample.rows = 1;
+        cpuSample.busy[0] = (float)(i * 37 % 100);
+        historyPush(&history, &memSample, &cpuSample, memSample.virtUsedGb);
+    }
+}
+
+// Renders the CPU graphics of a full history window into a frame
+static void benchCpuGraphics(void) {
+    frameBegin(0);
+    setCpuGraphics(&history);
+}
+
+// Renders the memory lines of a full history window into a frame
+static void benchMemoryLines(void) {
+    frameBegin(0);
+    fcnForPrintMemoryArr(0, &history, 1);
+}
+
+// Forks a child that echoes every MemSample of one ring into another
+static void setupRoundTrip(void) {
+    requestRing = ringCreate(16, sizeof(MemSample));
+    replyRing = ringCreate(16, sizeof(MemSample));
+    if (!requestRing || !replyRing) {
+        perror("Shared ring creation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    fflush(stdout);
+    echoPID = fork();
+    if (echoPID == -1) {
+        perror("Failed to fork");
+        exit(EXIT_FAILURE);
+    }
+    if (echoPID == 0) {
+        MemSample sample;
+        while (ringPop(requestRing, &sample) == 0)
+            ringPush(replyRing, &sample);
+        _exit(0);
+    }
+}
+
+// Sends one sample to the echo child and waits for it to come back
+static void benchRoundTrip(void) {
+    ringPush(requestRing, &memSample);
+    ringPop(replyRing, &memSample);
+}
+
+static void teardownRoundTrip(void) {
+    ringClose(requestRing);
+    waitpid(echoPID, NULL, 0);
+    ringDestroy(requestRing);
+    ringDestroy(replyRing);
+}
+
+// Push and pop in the same process: the cost of the ring itself
+static void setupRing(void) {
+    requestRing = ringCreate(16, sizeof(MemSample));
+    if (!requestRing) {
+        perror("Shared ring creation failed");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void benchRing(void) {
+    ringPush(requestRing, &memSample);
+    ringPop(requestRing, &memSample);
+}
+
+static void teardownRing(void) {
+    ringDestroy(requestRing);
+}
+
+// Runs op until BENCH_MIN_NS elapsed and prints ns/op and allocations/op
+static void runBench(const Bench *bench) {
+    unsigned long iterations = 0, batch = 1;
+
+    if (bench->setup)
+        bench->setup();
+    bench->op();    // warm-up: opens the persistent /proc descriptors
+
+    unsigned long allocsBefore = allocations;
+    uint64_t start = monotonicNs(), elapsed;
+    do {
+        for (unsigned long k = 0; k < batch; k++)
+            bench->op();
+        iterations += batch;
+        batch *= 2;
+        elapsed = monotonicNs() - start;
+    } while (elapsed < BENCH_MIN_NS);
+    unsigned long allocs = allocations - allocsBefore;
+
+    if (bench->teardown)
+        bench->teardown();
+
+    printf("%-34s %12.1f %12.2f %10lu\n", bench->name, (double)elapsed / iterations,
+           (double)allocs / iterations, iterations);
+}
+
+// Runs a program with stdout discarded; prints wall time, CPU time per sample and peak RSS
+static void runProgram(const char *label, char *const argv[]) {
+    struct rusage usage;
+    int status;
+    uint64_t start = monotonicNs();
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("Failed to fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        int null = open("/dev/null", O_RDWR);
+        dup2(null, STDIN_FILENO);
+        dup2(null, STDOUT_FILENO);
+        execv(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+
+    if (wait4(pid, &status, 0, &usage) == -1) {
+        perror("wait4");
+        return;
+    }
+    uint64_t wall = monotonicNs() - start;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("%-34s failed (status %d)\n", label, status);
+        return;
+    }
+
+    double cpuUs = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e6 +
+                   usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    printf("%-34s %10.1f %14.1f %10ld\n", label, wall / 1e6, cpuUs / E2E_SAMPLES, usage.ru_maxrss);
+}
+
+int main(void) {
+    const Bench benches[] = {
+        { "calculateCpuUsage (kernel only)", NULL, benchCpuKernel, NULL },
+        { "storeUserInfoThird (sampleUsers)", NULL, benchUsers, NULL },
+        { "rollupPush (10s,1m,5m windows)", setupRollup, benchRollup, teardownRollup },
+        { "alertsEvaluate (64 rules)", setupAlerts, benchAlerts, teardownAlerts },
+        { "codecEncode (64-core record)", setupCodec, benchCodec, teardownCodec },
+        { "fleet ingest (1000 agents x 16)", setupFleet, benchFleet, teardownFleet },
+        { "memoryGraphics", NULL, benchMemoryGraphics, NULL },
+        { "setCpuGraphics (full window)", setupHistory, benchCpuGraphics, NULL },
+        { "fcnForPrintMemoryArr (full window)", setupHistory, benchMemoryLines, NULL },
+        { "ring push + pop (same process)", setupRing, benchRing, teardownRing },
+        { "ring round-trip (collector child)", setupRoundTrip, benchRoundTrip, teardownRoundTrip },
+    };
+
+    static CpuCollector cpu;
+    if (cpuInit(&cpu) == -1) {
+        perror("Failed to open /proc/stat");
+        exit(EXIT_FAILURE);
+    }
+    storeCpuArr(&cpu, &snapshots[0]);
+    storeCpuArr(&cpu, &snapshots[1]);
+    cpuFree(&cpu);
+
+    printf("%-34s %12s %12s %10s\n", "benchmark", "ns/op", "allocs/op", "iterations");
+
+    // Every registered collector through the same init/sample/diff path
+    for (int i = 0; (benchedOps = collectorAt(i)) != NULL; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "collector %s (sample + diff)", benchedOps->name);
+        Bench bench = { name, setupCollector, benchCollector, teardownCollector };
+        runBench(&bench);
+    }
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+        runBench(&benches[i]);
+
+    // End to end: the same run through both programs (A1 sleeps whole seconds, so tdelay 0)
+    char *forkArgs[] = { "./mySystemStats", "--samples=50", "--tdelay=1ms", "--sequential", "--graphics", NULL };
+    char *loopArgs[] = { "./mySystemStats", "--samples=50", "--tdelay=1ms", "--sequential", "--graphics",
+                         "--engine=loop", NULL };
+    char *a1Args[] = { "./A1", "--samples=50", "--tdelay=0", "--sequential", "--graphics", NULL };
+
+    printf("\n%-34s %10s %14s %10s\n", "end to end (50 samples)", "wall ms", "cpu us/sample", "maxrss kB");
+    runProgram("mySystemStats --engine=fork", forkArgs);
+    runProgram("mySystemStats --engine=loop", loopArgs);
+    runProgram("A1", a1Args);
+    return 0;
+}
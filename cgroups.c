@@ -0,0 +1,378 @@
+#define _GNU_SOURCE
+
+#include "cgroups.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+
+static const char *pressureFiles[PSI_RESOURCES] = { "cpu.pressure", "memory.pressure", "io.pressure" };
+
+// Opens the cgroup2 mount (unified or hybrid layout) and raises the descriptor limit for the group fds
+int cgroupInit(CgroupCollector *cg) {
+    static const char *mounts[] = { "/sys/fs/cgroup", "/sys/fs/cgroup/unified" };
+
+    memset(cg, 0, sizeof(CgroupCollector));
+    cg->rootFd = cg->statFd = -1;
+    for (size_t i = 0; i < sizeof(mounts) / sizeof(mounts[0]) && cg->rootFd == -1; i++) {
+        int fd = open(mounts[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd != -1 && faccessat(fd, "cgroup.controllers", R_OK, 0) == 0)
+            cg->rootFd = fd;
+        else if (fd != -1)
+            close(fd);
+    }
+    if (cg->rootFd == -1)
+        return -1;
+
+    cg->fdBudget = procReserveFds(CGROUP_FD_SHARE);
+    cg->rescan = 1;
+    return 0;
+}
+
+static uint32_t pathHash(const char *path) {
+    uint32_t hash = 2166136261u;
+    while (*path)
+        hash = (hash ^ (unsigned char)*path++) * 16777619u;
+    return hash;
+}
+
+// Returns the slot holding path, or the empty slot where it would go
+static int *pathSlot(CgroupCollector *cg, const char *path) {
+    uint32_t i = pathHash(path) & (CGROUP_TABLE_SIZE - 1);
+
+    while (cg->slots[i] && strcmp(cg->groups[cg->slots[i] - 1].path, path) != 0)
+        i = (i + 1) & (CGROUP_TABLE_SIZE - 1);
+    return &cg->slots[i];
+}
+
+static void closeCached(CgroupCollector *cg, int *fd) {
+    if (*fd >= 0) {
+        close(*fd);
+        cg->openFds--;
+    }
+    *fd = -1;
+}
+
+// Lists the child groups of dirFd, depth first, adding the new ones
+static void walkGroups(CgroupCollector *cg, int dirFd, const char *path, int depth) {
+    int fd = openat(dirFd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR *dir = fd == -1 ? NULL : fdopendir(fd);
+    struct dirent *dent;
+
+    if (!dir) {
+        if (fd != -1)
+            close(fd);
+        return;
+    }
+
+    while ((dent = readdir(dir)) != NULL) {
+        char child[CGROUP_PATH_LEN];
+
+        if (dent->d_type != DT_DIR || dent->d_name[0] == '.')
+            continue;
+        if (snprintf(child, sizeof(child), "%s%s%s", path, path[0] ? "/" : "", dent->d_name) >= (int)sizeof(child))
+            continue;
+
+        int *slot = pathSlot(cg, child);
+        if (!*slot) {
+            if (cg->count == MAX_CGROUPS || cg->openFds >= cg->fdBudget)
+                continue;
+            int groupFd = openat(dirFd, dent->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (groupFd == -1)
+                continue;
+
+            CgroupEntry *entry = &cg->groups[cg->count];
+            memset(entry, 0, sizeof(CgroupEntry));
+            memcpy(entry->path, child, sizeof(child));
+            entry->dirFd = groupFd;
+            entry->cpuFd = entry->memFd = -1;
+            entry->fresh = 1;
+            cg->openFds++;
+            *slot = ++cg->count;
+        }
+
+        CgroupEntry *entry = &cg->groups[*slot - 1];
+        entry->seen = cg->generation;
+        if (depth + 1 < CGROUP_MAX_DEPTH)
+            walkGroups(cg, entry->dirFd, entry->path, depth + 1);
+    }
+    closedir(dir);
+}
+
+// Closes every descriptor of a group whose reads fail; the next rescan evicts it
+static void markStale(CgroupCollector *cg, CgroupEntry *entry) {
+    closeCached(cg, &entry->cpuFd);
+    closeCached(cg, &entry->memFd);
+    closeCached(cg, &entry->dirFd);
+    entry->stale = 1;
+    cg->rescan = 1;
+}
+
+// Drops the stale groups (and, with unseen set, those the last walk did not list), then rebuilds the path hash
+static void evictGroups(CgroupCollector *cg, int unseen) {
+    int kept = 0;
+
+    for (int i = 0; i < cg->count; i++) {
+        CgroupEntry *entry = &cg->groups[i];
+        if (entry->stale || (unseen && entry->seen != cg->generation)) {
+            closeCached(cg, &entry->cpuFd);
+            closeCached(cg, &entry->memFd);
+            closeCached(cg, &entry->dirFd);
+            continue;
+        }
+        if (kept != i)
+            cg->groups[kept] = *entry;
+        kept++;
+    }
+
+    cg->count = kept;
+    memset(cg->slots, 0, sizeof(cg->slots));
+    for (int i = 0; i < cg->count; i++)
+        *pathSlot(cg, cg->groups[i].path) = i + 1;
+}
+
+// Re-lists the hierarchy and drops the groups that are gone. Stale groups are evicted
+// before the walk, so a group recreated under the same path comes back as a fresh entry.
+static void rescanGroups(CgroupCollector *cg) {
+    evictGroups(cg, 0);
+    cg->generation++;
+    walkGroups(cg, cg->rootFd, "", 0);
+    evictGroups(cg, 1);
+    cg->rescan = 0;
+}
+
+// Reads a file of a group, through its cached descriptor when there is one; returns bytes read or -1
+static ssize_t readGroupFile(CgroupCollector *cg, CgroupEntry *entry, int *cached, const char *name,
+                             char *buf, size_t size) {
+    ssize_t n;
+
+    if (cached && *cached == -2)
+        return -1;  // known to be absent (controller not enabled)
+
+    if (cached && *cached >= 0)
+        n = pread(*cached, buf, size - 1, 0);
+    else {
+        int fd = openat(entry->dirFd, name, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            if (cached && errno == ENOENT)
+                *cached = -2;
+            return -1;
+        }
+        n = pread(fd, buf, size - 1, 0);
+        if (cached && n >= 0 && cg->openFds < cg->fdBudget) {
+            *cached = fd;
+            cg->openFds++;
+        } else
+            close(fd);
+    }
+
+    buf[n > 0 ? n : 0] = '\0';
+    return n;
+}
+
+// Finds "key value" lines (key includes its trailing space) in a flat-keyed file
+static uint64_t statValue(const char *buf, const char *key) {
+    size_t len = strlen(key);
+    uint64_t value = 0;
+
+    for (const char *p = buf; *p; p = procSkipLine(p))
+        if (strncmp(p, key, len) == 0) {
+            procScanU64(p + len, &value);
+            break;
+        }
+    return value;
+}
+
+// Sums one "key=value" field over every device line of io.stat
+static uint64_t ioStatSum(const char *buf, const char *key) {
+    size_t len = strlen(key);
+    uint64_t sum = 0, value;
+
+    for (const char *p = strstr(buf, key); p; p = strstr(p + len, key))
+        if (procScanU64(p + len, &value))
+            sum += value;
+    return sum;
+}
+
+// Growth of a counter; a counter that went backwards (group recreated or reset) counts as 0
+static double counterDelta(uint64_t curr, uint64_t prev) {
+    return curr < prev ? 0.0 : (double)(curr - prev);
+}
+
+// Offers a row to the sorted top-CGROUP_SHOWN table
+static void offerRow(CgroupSample *sample, const CgroupRow *row) {
+    int i = sample->count < CGROUP_SHOWN ? sample->count++ : CGROUP_SHOWN;
+
+    while (i > 0 && (sample->rows[i - 1].cpuPercent < row->cpuPercent ||
+                     (sample->rows[i - 1].cpuPercent == row->cpuPercent &&
+                      sample->rows[i - 1].memoryMb < row->memoryMb))) {
+        if (i < CGROUP_SHOWN)
+            sample->rows[i] = sample->rows[i - 1];
+        i--;
+    }
+    if (i < CGROUP_SHOWN)
+        sample->rows[i] = *row;
+}
+
+// Reads every group once and fills sample with the busiest. Each tick costs one pread() of
+// cpu.stat and memory.current per group; memory.stat, io.stat and the pressure files are only
+// read for groups whose usage or memory moved (and for all groups every CGROUP_RESCAN_TICKS).
+void sampleCgroups(CgroupCollector *cg, CgroupSample *sample) {
+    char buf[CGROUP_BUFSIZE];
+    uint64_t now = monotonicNs();
+    double elapsedUs = cg->lastScanNs ? (now - cg->lastScanNs) / 1e3 : 0.0;
+    int full = cg->ticks % CGROUP_RESCAN_TICKS == 0;
+
+    // cgroup.stat of the root counts descendants: a cheap trigger for a rescan
+    if (cg->statFd == -1)
+        cg->statFd = openat(cg->rootFd, "cgroup.stat", O_RDONLY | O_CLOEXEC);
+    ssize_t n = cg->statFd == -1 ? -1 : pread(cg->statFd, buf, sizeof(buf) - 1, 0);
+    if (n > 0) {
+        buf[n] = '\0';
+        uint64_t descendants = statValue(buf, "nr_descendants ");
+        if (descendants != cg->descendants)
+            cg->rescan = 1;
+        cg->descendants = descendants;
+    }
+    if (cg->rescan || full)
+        rescanGroups(cg);
+
+    sample->count = sample->skipped = 0;
+    sample->tracked = cg->count;
+    sample->available = 1;
+
+    for (int i = 0; i < cg->count; i++) {
+        CgroupEntry *entry = &cg->groups[i];
+        uint64_t usageUs, throttledUs, memoryBytes = 0;
+        CgroupRow row;
+
+        if (readGroupFile(cg, entry, &entry->cpuFd, "cpu.stat", buf, sizeof(buf)) <= 0) {
+            markStale(cg, entry);   // removed, or recreated behind our descriptors, since the last rescan
+            continue;
+        }
+        usageUs = statValue(buf, "usage_usec ");
+        throttledUs = statValue(buf, "throttled_usec ");
+        if (readGroupFile(cg, entry, &entry->memFd, "memory.current", buf, sizeof(buf)) > 0)
+            procScanU64(buf, &memoryBytes);
+
+        memset(&row, 0, sizeof(row));
+        memcpy(row.path, entry->path, sizeof(row.path));
+        if (!entry->fresh && elapsedUs > 0) {
+            row.cpuPercent = (float)(counterDelta(usageUs, entry->usageUs) / elapsedUs * 100.0);
+            row.throttledPercent = (float)(counterDelta(throttledUs, entry->throttledUs) / elapsedUs * 100.0);
+        }
+
+        int unchanged = !entry->fresh && !full && usageUs == entry->usageUs && memoryBytes == entry->memoryBytes;
+        if (unchanged)
+            sample->skipped++;
+        else {
+            uint64_t readBytes = 0, writeBytes = 0;
+
+            if (readGroupFile(cg, entry, NULL, "memory.stat", buf, sizeof(buf)) > 0) {
+                entry->anonBytes = statValue(buf, "anon ");
+                entry->fileBytes = statValue(buf, "file ");
+            }
+            if (readGroupFile(cg, entry, NULL, "io.stat", buf, sizeof(buf)) >= 0) {
+                readBytes = ioStatSum(buf, "rbytes=");
+                writeBytes = ioStatSum(buf, "wbytes=");
+                if (!entry->fresh && elapsedUs > 0) {
+                    row.readKBps = (float)(counterDelta(readBytes, entry->readBytes) / 1024.0 / (elapsedUs / 1e6));
+                    row.writeKBps = (float)(counterDelta(writeBytes, entry->writeBytes) / 1024.0 / (elapsedUs / 1e6));
+                }
+                entry->readBytes = readBytes;
+                entry->writeBytes = writeBytes;
+            }
+            for (int r = 0; r < PSI_RESOURCES; r++) {
+                PsiLine line;
+                if (readGroupFile(cg, entry, NULL, pressureFiles[r], buf, sizeof(buf)) > 0 &&
+                    parsePsiLine(buf, "some", &line) == 0)
+                    entry->pressure[r] = line.avg10;
+            }
+        }
+
+        entry->usageUs = usageUs;
+        entry->throttledUs = throttledUs;
+        entry->memoryBytes = memoryBytes;
+        entry->fresh = 0;
+
+        row.memoryMb = memoryBytes / (1024.0f * 1024.0f);
+        row.anonMb = entry->anonBytes / (1024.0f * 1024.0f);
+        row.fileMb = entry->fileBytes / (1024.0f * 1024.0f);
+        memcpy(row.pressure, entry->pressure, sizeof(row.pressure));
+        offerRow(sample, &row);
+    }
+
+    sample->intervalNs = cg->lastScanNs ? now - cg->lastScanNs : 0;
+    sample->header.timestampNs = now;
+    cg->lastScanNs = now;
+    cg->ticks++;
+}
+
+// Takes a baseline on tick 0, then pushes the busiest groups on every tick
+void storeCgroupSamples(SampleClock *clock, SampleRing *cgroupRing) {
+    collectorRun("cgroups", clock, cgroupRing);
+}
+
+// Closes every cached descriptor and the mount
+void cgroupFree(CgroupCollector *cg) {
+    for (int i = 0; i < cg->count; i++) {
+        closeCached(cg, &cg->groups[i].cpuFd);
+        closeCached(cg, &cg->groups[i].memFd);
+        closeCached(cg, &cg->groups[i].dirFd);
+    }
+    cg->count = 0;
+    procReleaseFds(cg->fdBudget);
+    cg->fdBudget = 0;
+    if (cg->statFd != -1)
+        close(cg->statFd);
+    if (cg->rootFd != -1)
+        close(cg->rootFd);
+    cg->rootFd = cg->statFd = -1;
+}
+
+// A host without cgroup v2 still opens; its samples carry available = 0
+static int cgroupCollectorInit(void *state) {
+    cgroupInit(state);
+    return 0;
+}
+
+static int cgroupCollectorSample(void *state, void *out) {
+    CgroupCollector *cg = state;
+    CgroupSample *sample = out;
+
+    if (cg->rootFd != -1)
+        sampleCgroups(cg, sample);
+    sample->available = cg->rootFd != -1;
+    return 0;
+}
+
+static void cgroupCollectorTeardown(void *state) {
+    cgroupFree(state);
+}
+
+const CollectorOps cgroupCollector = {
+    .name = "cgroups", .stateSize = sizeof(CgroupCollector), .sampleSize = sizeof(CgroupSample),
+    .latencyPhase = LAT_COLLECT_CGROUP, .init = cgroupCollectorInit, .sample = cgroupCollectorSample,
+    .teardown = cgroupCollectorTeardown,
+};
+
+// Prints the per-cgroup table
+void printCgroups(const CgroupSample *sample) {
+    if (!sample->available) {
+        renderf("### Cgroups ### (no cgroup v2 hierarchy)\n");
+        return;
+    }
+
+    renderf("### Cgroups ### (%d tracked, %d unchanged)\n", sample->tracked, sample->skipped);
+    renderf("%-32s %7s %6s %9s %8s %8s %8s %8s %5s %5s %5s\n", "CGROUP", "CPU%", "THR%", "MEM MB", "ANON MB",
+            "FILE MB", "RD KB/s", "WR KB/s", "PCPU", "PMEM", "PIO");
+
+    for (int i = 0; i < sample->count; i++) {
+        const CgroupRow *row = &sample->rows[i];
+        size_t len = strlen(row->path);
+        const char *path = len > 32 ? row->path + len - 32 : row->path;   // keep the leaf visible
+
+        renderf("%-32s %7.2f %6.2f %9.1f %8.1f %8.1f %8.1f %8.1f %5.1f %5.1f %5.1f\n", path, row->cpuPercent,
+                row->throttledPercent, row->memoryMb, row->anonMb, row->fileMb, row->readKBps, row->writeKBps,
+                row->pressure[0], row->pressure[1], row->pressure[2]);
+    }
+}
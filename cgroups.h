@@ -0,0 +1,67 @@
+#ifndef CGROUPS_H
+#define CGROUPS_H
+
+#include "stats_functions.h"
+#include "psi.h"
+
+#define MAX_CGROUPS 4096
+#define CGROUP_TABLE_SIZE 8192          // path hash slots (power of two, twice MAX_CGROUPS)
+#define CGROUP_PATH_LEN 96
+#define CGROUP_MAX_DEPTH 16
+#define CGROUP_SHOWN 16                 // table rows drawn per frame
+#define CGROUP_RESCAN_TICKS 10          // full rescan (and full re-read) every this many ticks
+#define CGROUP_BUFSIZE 4096
+#define CGROUP_FD_SHARE 40              // % of the process-wide descriptor pool (see procReserveFds)
+
+// Per-group state kept across ticks; the directory descriptor stays open
+typedef struct {
+    char path[CGROUP_PATH_LEN];         // relative to the cgroup2 mount
+    int dirFd;
+    int cpuFd, memFd;                   // cached cpu.stat / memory.current; -2 when the file is absent
+    uint64_t seen;                      // rescan generation that last listed the group
+    int stale;                          // a read failed: descriptors closed, evicted on the next rescan
+    int fresh;                          // no baseline yet
+    uint64_t usageUs, throttledUs;
+    uint64_t memoryBytes, anonBytes, fileBytes;
+    uint64_t readBytes, writeBytes;
+    float pressure[PSI_RESOURCES];      // "some" avg10 of cpu, memory, io
+} CgroupEntry;
+
+typedef struct {
+    int rootFd, statFd;                 // the cgroup2 mount and its cgroup.stat
+    int count;
+    int fdBudget, openFds;
+    int rescan;                         // set when a group vanished (or was recreated) between rescans
+    uint64_t generation, descendants;
+    uint64_t ticks, lastScanNs;
+    int slots[CGROUP_TABLE_SIZE];       // path hash -> entry index + 1
+    CgroupEntry groups[MAX_CGROUPS];
+} CgroupCollector;
+
+// One table row: rates over the last interval, sizes at the end of it
+typedef struct {
+    char path[CGROUP_PATH_LEN];
+    float cpuPercent, throttledPercent;
+    float memoryMb, anonMb, fileMb;
+    float readKBps, writeKBps;
+    float pressure[PSI_RESOURCES];
+} CgroupRow;
+
+// The busiest groups of one interval, sorted by CPU% then memory; available is 0 without cgroup v2
+typedef struct {
+    SampleHeader header;
+    uint64_t intervalNs;
+    int available;
+    int tracked, skipped;               // groups walked, and groups skipped as unchanged
+    int count;
+    CgroupRow rows[CGROUP_SHOWN];
+} CgroupSample;
+
+// Function prototypes
+int cgroupInit(CgroupCollector *cg);
+void sampleCgroups(CgroupCollector *cg, CgroupSample *sample);
+void storeCgroupSamples(SampleClock *clock, SampleRing *cgroupRing);
+void cgroupFree(CgroupCollector *cg);
+void printCgroups(const CgroupSample *sample);
+
+#endif // CGROUPS_H
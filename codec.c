@@ -0,0 +1,226 @@
+#include "codec.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const unsigned char *stream;
+    uint64_t pos, limit;        // in bits
+    int overrun;
+} BitReader;
+
+// Allocates the per-word state for records of recordSize bytes
+int codecInit(ChunkCodec *codec, uint32_t recordSize, uint64_t intervalNs) {
+    memset(codec, 0, sizeof(ChunkCodec));
+    codec->recordSize = recordSize;
+    codec->words = (recordSize - sizeof(uint64_t)) / sizeof(uint32_t);
+    codec->intervalNs = intervalNs;
+
+    codec->prev = malloc(codec->words * sizeof(uint32_t));
+    codec->lead = malloc(codec->words);
+    codec->len = malloc(codec->words);
+    if (!codec->prev || !codec->lead || !codec->len) {
+        codecFree(codec);
+        return -1;
+    }
+    return 0;
+}
+
+void codecFree(ChunkCodec *codec) {
+    free(codec->prev);
+    free(codec->lead);
+    free(codec->len);
+    codec->prev = NULL;
+    codec->lead = codec->len = NULL;
+}
+
+// Worst case: 68-bit delta-of-delta for the timestamp and counters, 44 bits per float
+size_t codecMaxRecordBytes(const ChunkCodec *codec) {
+    return (68 * (1 + CODEC_INT_WORDS) + 44 * (codec->words - CODEC_INT_WORDS)) / 8 + 1;
+}
+
+// Starts a new chunk
+void codecReset(ChunkCodec *codec) {
+    codec->records = 0;
+    codec->bits = 0;
+}
+
+// Appends the low `bits` bits of value, most significant first, to a zero-filled stream
+static void putBits(unsigned char *stream, uint64_t *pos, uint64_t value, int bits) {
+    while (bits > 0) {
+        int room = 8 - (int)(*pos & 7);
+        int take = bits < room ? bits : room;
+        unsigned part = (unsigned)(value >> (bits - take)) & ((1u << take) - 1);
+
+        stream[*pos >> 3] |= (unsigned char)(part << (room - take));
+        *pos += take;
+        bits -= take;
+    }
+}
+
+static uint64_t getBits(BitReader *reader, int bits) {
+    uint64_t value = 0;
+
+    if (reader->pos + bits > reader->limit) {
+        reader->overrun = 1;
+        return 0;
+    }
+    while (bits > 0) {
+        int room = 8 - (int)(reader->pos & 7);
+        int take = bits < room ? bits : room;
+        unsigned byte = reader->stream[reader->pos >> 3];
+
+        value = (value << take) | ((byte >> (room - take)) & ((1u << take) - 1));
+        reader->pos += take;
+        bits -= take;
+    }
+    return value;
+}
+
+// Variable-length signed integer: '0' for 0, then 7, 20, 32 or 64-bit two's complement
+static void putSigned(unsigned char *stream, uint64_t *pos, int64_t value) {
+    if (value == 0)
+        putBits(stream, pos, 0, 1);
+    else if (value >= -64 && value < 64) {
+        putBits(stream, pos, 0x2, 2);
+        putBits(stream, pos, (uint64_t)value, 7);
+    } else if (value >= -(1 << 19) && value < (1 << 19)) {
+        putBits(stream, pos, 0x6, 3);
+        putBits(stream, pos, (uint64_t)value, 20);
+    } else if (value >= INT32_MIN && value <= INT32_MAX) {
+        putBits(stream, pos, 0xe, 4);
+        putBits(stream, pos, (uint64_t)value, 32);
+    } else {
+        putBits(stream, pos, 0xf, 4);
+        putBits(stream, pos, (uint64_t)value, 64);
+    }
+}
+
+static int64_t signExtend(uint64_t value, int bits) {
+    uint64_t sign = 1ull << (bits - 1);
+    return (int64_t)((value ^ sign) - sign);
+}
+
+static int64_t getSigned(BitReader *reader) {
+    if (!getBits(reader, 1))
+        return 0;
+    if (!getBits(reader, 1))
+        return signExtend(getBits(reader, 7), 7);
+    if (!getBits(reader, 1))
+        return signExtend(getBits(reader, 20), 20);
+    if (!getBits(reader, 1))
+        return signExtend(getBits(reader, 32), 32);
+    return (int64_t)getBits(reader, 64);
+}
+
+// Appends one record to the current chunk; the stream must have codecMaxRecordBytes() of zeroed room
+void codecEncode(ChunkCodec *codec, unsigned char *stream, const unsigned char *record) {
+    uint64_t timestampNs;
+    uint32_t word;
+
+    memcpy(&timestampNs, record, sizeof(timestampNs));
+
+    if (codec->records == 0) {
+        putBits(stream, &codec->bits, timestampNs, 64);
+        for (uint32_t w = 0; w < codec->words; w++) {
+            memcpy(&word, record + sizeof(uint64_t) + w * sizeof(uint32_t), sizeof(word));
+            putBits(stream, &codec->bits, word, 32);
+            codec->prev[w] = word;
+            codec->len[w] = 0;
+        }
+        codec->prevTimestampNs = timestampNs;
+        codec->prevDeltaNs = (int64_t)codec->intervalNs;
+        memset(codec->prevCounterDelta, 0, sizeof(codec->prevCounterDelta));
+        codec->records = 1;
+        return;
+    }
+
+    int64_t delta = (int64_t)(timestampNs - codec->prevTimestampNs);
+    putSigned(stream, &codec->bits, delta - codec->prevDeltaNs);
+    codec->prevTimestampNs = timestampNs;
+    codec->prevDeltaNs = delta;
+
+    for (uint32_t w = 0; w < codec->words; w++) {
+        memcpy(&word, record + sizeof(uint64_t) + w * sizeof(uint32_t), sizeof(word));
+
+        if (w < CODEC_INT_WORDS) {
+            int64_t counterDelta = (int64_t)word - (int64_t)codec->prev[w];
+            putSigned(stream, &codec->bits, counterDelta - codec->prevCounterDelta[w]);
+            codec->prevCounterDelta[w] = counterDelta;
+            codec->prev[w] = word;
+            continue;
+        }
+
+        uint32_t xor = word ^ codec->prev[w];
+        codec->prev[w] = word;
+        if (xor == 0) {
+            putBits(stream, &codec->bits, 0, 1);
+            continue;
+        }
+
+        int lead = __builtin_clz(xor), trail = __builtin_ctz(xor);
+        if (codec->len[w] && lead >= codec->lead[w] && trail >= 32 - codec->lead[w] - codec->len[w]) {
+            // Fits the previous window: only the meaningful bits
+            putBits(stream, &codec->bits, 0x2, 2);
+            putBits(stream, &codec->bits, xor >> (32 - codec->lead[w] - codec->len[w]), codec->len[w]);
+        } else {
+            int len = 32 - lead - trail;
+            putBits(stream, &codec->bits, 0x3, 2);
+            putBits(stream, &codec->bits, lead, 5);
+            putBits(stream, &codec->bits, len - 1, 5);
+            putBits(stream, &codec->bits, xor >> trail, len);
+            codec->lead[w] = lead;
+            codec->len[w] = len;
+        }
+    }
+    codec->records++;
+}
+
+// Decodes up to `records` records of one chunk into out; returns how many were intact
+uint32_t codecDecode(ChunkCodec *codec, const unsigned char *stream, size_t bytes, uint32_t records,
+                     unsigned char *out) {
+    BitReader reader = { stream, 0, (uint64_t)bytes * 8, 0 };
+    uint64_t timestampNs = 0;
+    int64_t deltaNs = (int64_t)codec->intervalNs;
+    int64_t counterDelta[CODEC_INT_WORDS] = { 0 };
+
+    for (uint32_t r = 0; r < records; r++) {
+        unsigned char *record = out + (size_t)r * codec->recordSize;
+
+        if (r == 0)
+            timestampNs = getBits(&reader, 64);
+        else {
+            deltaNs += getSigned(&reader);
+            timestampNs += deltaNs;
+        }
+        memcpy(record, &timestampNs, sizeof(timestampNs));
+
+        for (uint32_t w = 0; w < codec->words; w++) {
+            uint32_t word;
+
+            if (r == 0) {
+                word = (uint32_t)getBits(&reader, 32);
+                codec->len[w] = 0;
+            } else if (w < CODEC_INT_WORDS) {
+                counterDelta[w] += getSigned(&reader);
+                word = codec->prev[w] + (uint32_t)counterDelta[w];
+            } else if (!getBits(&reader, 1))
+                word = codec->prev[w];
+            else {
+                if (getBits(&reader, 1)) {
+                    codec->lead[w] = (uint8_t)getBits(&reader, 5);
+                    codec->len[w] = (uint8_t)getBits(&reader, 5) + 1;
+                }
+                if (codec->len[w] == 0 || codec->lead[w] + codec->len[w] > 32)
+                    return r;
+                word = codec->prev[w] ^
+                       (uint32_t)(getBits(&reader, codec->len[w]) << (32 - codec->lead[w] - codec->len[w]));
+            }
+            memcpy(record + sizeof(uint64_t) + w * sizeof(uint32_t), &word, sizeof(word));
+            codec->prev[w] = word;
+        }
+
+        if (reader.overrun)
+            return r;
+    }
+    return records;
+}
@@ -0,0 +1,45 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CODEC_CHUNK_RECORDS 128     // records per independently decodable chunk
+#define CODEC_INT_WORDS 2           // leading 32-bit words that are counters (tick, sessions)
+
+// A chunk in a compressed record file: this header, then `bytes` of bit stream,
+// padded to 8 bytes. The first record of a chunk is stored raw, so a chunk decodes
+// without anything that came before it.
+typedef struct {
+    uint32_t bytes;             // bit stream length; grows as records are appended
+    uint32_t records;           // records complete in this chunk
+    uint64_t timestampNs;       // timestamp of the first record
+} ChunkHeader;
+
+// Encoder/decoder state for one chunk of fixed-width records laid out as
+// a uint64 timestamp followed by 32-bit words: CODEC_INT_WORDS counters,
+// then floats. Timestamps and counters are stored as delta-of-delta,
+// floats as the XOR with the previous value of the same word (Gorilla).
+typedef struct {
+    uint32_t recordSize;
+    uint32_t words;             // 32-bit words after the timestamp
+    uint64_t intervalNs;        // expected timestamp delta; a regular tick costs one bit
+    uint32_t records;           // records in the current chunk
+    uint64_t bits;              // bit stream position in the current chunk
+    uint64_t prevTimestampNs;
+    int64_t prevDeltaNs;
+    int64_t prevCounterDelta[CODEC_INT_WORDS];
+    uint32_t *prev;             // previous value of every word
+    uint8_t *lead, *len;        // XOR window (leading zeros, meaningful bits) of every float word
+} ChunkCodec;
+
+// Function prototypes
+int codecInit(ChunkCodec *codec, uint32_t recordSize, uint64_t intervalNs);
+void codecFree(ChunkCodec *codec);
+size_t codecMaxRecordBytes(const ChunkCodec *codec);
+void codecReset(ChunkCodec *codec);
+void codecEncode(ChunkCodec *codec, unsigned char *stream, const unsigned char *record);
+uint32_t codecDecode(ChunkCodec *codec, const unsigned char *stream, size_t bytes, uint32_t records,
+                     unsigned char *out);
+
+#endif // CODEC_H
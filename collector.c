@@ -0,0 +1,116 @@
+#include "collector.h"
+#include "latency.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const CollectorOps *registry[MAX_REGISTERED_COLLECTORS] = {
+    &memCollector, &cpuCollector, &topCollector, &diskCollector, &netCollector, &psiCollector, &cgroupCollector
+};
+static int registered = 7;
+
+// Adds a collector to the registry; returns -1 if the name is taken, the registry is full
+// or latencyPhase is not one of the LAT_COLLECT_* phases (the engines index tables by it)
+int collectorRegister(const CollectorOps *ops) {
+    if (collectorFind(ops->name) || registered == MAX_REGISTERED_COLLECTORS ||
+        ops->latencyPhase < 0 || ops->latencyPhase >= LAT_COLLECTORS)
+        return -1;
+    registry[registered++] = ops;
+    return 0;
+}
+
+const CollectorOps *collectorFind(const char *name) {
+    for (int i = 0; i < registered; i++)
+        if (strcmp(registry[i]->name, name) == 0)
+            return registry[i];
+    return NULL;
+}
+
+// Returns the index-th registered collector, or NULL past the end
+const CollectorOps *collectorAt(int index) {
+    return index >= 0 && index < registered ? registry[index] : NULL;
+}
+
+// Allocates the state and snapshot buffers of a registered collector and initialises it
+int collectorOpen(Collector *collector, const char *name) {
+    const CollectorOps *ops = collectorFind(name);
+
+    memset(collector, 0, sizeof(Collector));
+    if (!ops)
+        return -1;
+    collector->ops = ops;
+
+    collector->state = calloc(1, ops->stateSize ? ops->stateSize : 1);
+    if (ops->snapshotSize) {
+        collector->snapshots[0] = calloc(1, ops->snapshotSize);
+        collector->snapshots[1] = calloc(1, ops->snapshotSize);
+    }
+    if (!collector->state || (ops->snapshotSize && (!collector->snapshots[0] || !collector->snapshots[1])) ||
+        (ops->init && ops->init(collector->state) == -1)) {
+        free(collector->state);
+        free(collector->snapshots[0]);
+        free(collector->snapshots[1]);
+        collector->ops = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Fills sample; returns 0 when it holds a new sample, 1 when the call only took
+// a snapshot collector's baseline, -1 on error
+int collectorSample(Collector *collector, void *sample) {
+    const CollectorOps *ops = collector->ops;
+
+    if (!ops->snapshotSize)
+        return ops->sample(collector->state, sample);
+
+    if (ops->sample(collector->state, collector->snapshots[collector->current ^ 1]) == -1)
+        return -1;
+    collector->current ^= 1;
+    if (!collector->primed) {
+        collector->primed = 1;
+        return 1;
+    }
+    ops->diff(collector->state, collector->snapshots[collector->current ^ 1],
+              collector->snapshots[collector->current], sample);
+    return 0;
+}
+
+void collectorClose(Collector *collector) {
+    if (!collector->ops)
+        return;
+    if (collector->ops->teardown)
+        collector->ops->teardown(collector->state);
+    free(collector->state);
+    free(collector->snapshots[0]);
+    free(collector->snapshots[1]);
+    collector->ops = NULL;
+}
+
+// Body of a collector child: takes the baseline on tick 0, then pushes one sample per tick
+void collectorRun(const char *name, SampleClock *clock, SampleRing *ring) {
+    Collector collector;
+    uint32_t tick = CLOCK_NOT_STARTED;
+    void *sample = NULL;
+
+    if (collectorOpen(&collector, name) == -1 || !(sample = calloc(1, collector.ops->sampleSize))) {
+        perror(name);
+        collectorClose(&collector);
+        ringClose(ring);
+        return;
+    }
+
+    while (clockWaitTick(clock, &tick) == 0) {
+        uint64_t start = monotonicNs();
+        if (collectorSample(&collector, sample) == 0 && tick > 0) {
+            SampleHeader *header = sample;
+            header->tick = tick;
+            latencyStamp(header, start);
+            ringPush(ring, sample);
+        }
+    }
+
+    free(sample);
+    collectorClose(&collector);
+    ringClose(ring);
+}
@@ -0,0 +1,50 @@
+#ifndef COLLECTOR_H
+#define COLLECTOR_H
+
+#include <stddef.h>
+#include "sample_ring.h"
+#include "scheduler.h"
+
+#define MAX_REGISTERED_COLLECTORS 32
+
+// The interface every sampled collector implements, so engines, the benchmark
+// and embedding programs can drive any of them the same way. Samples start
+// with a SampleHeader. Snapshot collectors (snapshotSize > 0) read raw
+// counters with sample() and diff() turns two consecutive snapshots into a
+// sample; the others sample() straight into the sample. An unavailable source
+// is reported inside the sample (e.g. PsiSample.available), not as an error.
+typedef struct {
+    const char *name;
+    size_t stateSize;           // private state, zeroed before init()
+    size_t snapshotSize;        // 0 when sample() fills the sample directly
+    size_t sampleSize;
+    int latencyPhase;           // LAT_COLLECT_* phase the engines time it under (a plugin shares one)
+    int (*init)(void *state);   // may be NULL; returns -1 on failure
+    int (*sample)(void *state, void *out);
+    void (*diff)(void *state, const void *prev, const void *curr, void *sample);
+    void (*teardown)(void *state);  // may be NULL
+} CollectorOps;
+
+// An open collector: its state and the two snapshot buffers it alternates between
+typedef struct {
+    const CollectorOps *ops;
+    void *state;
+    void *snapshots[2];
+    int current;
+    int primed;
+} Collector;
+
+// Built-in collectors (defined next to the code they wrap)
+extern const CollectorOps memCollector, cpuCollector, topCollector, diskCollector;
+extern const CollectorOps netCollector, psiCollector, cgroupCollector;
+
+// Function prototypes
+int collectorRegister(const CollectorOps *ops);
+const CollectorOps *collectorFind(const char *name);
+const CollectorOps *collectorAt(int index);
+int collectorOpen(Collector *collector, const char *name);
+int collectorSample(Collector *collector, void *sample);
+void collectorClose(Collector *collector);
+void collectorRun(const char *name, SampleClock *clock, SampleRing *ring);
+
+#endif // COLLECTOR_H
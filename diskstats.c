@@ -0,0 +1,153 @@
+#define _GNU_SOURCE
+
+#include "diskstats.h"
+
+// Opens /proc/diskstats for the lifetime of the collector
+int diskInit(DiskCollector *disk) {
+    return procOpen(&disk->diskstats, "/proc/diskstats", disk->buf, sizeof(disk->buf));
+}
+
+void diskFree(DiskCollector *disk) {
+    procClose(&disk->diskstats);
+}
+
+// Reads every device row of /proc/diskstats into a snapshot
+void storeDiskArr(DiskCollector *disk, DiskSnapshot *snapshot) {
+    int rows = 0;
+
+    if (procRead(&disk->diskstats) == -1) {
+        perror("Failed to read /proc/diskstats");
+        exit(EXIT_FAILURE);
+    }
+
+    // "major minor name" then reads, merged, sectors, ms, writes, merged, sectors, ms, in flight, io ms, weighted ms
+    const char *p = disk->diskstats.buf;
+    while (*p && rows < MAX_DISKS) {
+        uint64_t f[11] = {0}, id;
+        const char *next = procScanU64(p, &id);
+
+        if (next && (next = procScanU64(next, &id)) != NULL) {
+            next = procSkipSpaces(next);
+            size_t len = 0;
+            while (next[len] && next[len] != ' ' && next[len] != '\n')
+                len++;
+            if (len >= DISK_NAME_LEN)
+                len = DISK_NAME_LEN - 1;
+            memcpy(snapshot->name[rows], next, len);
+            snapshot->name[rows][len] = '\0';
+
+            next += len;
+            for (int k = 0; k < 11 && next; k++)
+                next = procScanU64(next, &f[k]);
+
+            snapshot->reads[rows] = f[0];
+            snapshot->readSectors[rows] = f[2];
+            snapshot->writes[rows] = f[4];
+            snapshot->writeSectors[rows] = f[6];
+            snapshot->ioMs[rows] = f[9];
+            snapshot->weightedMs[rows] = f[10];
+            rows++;
+        }
+        p = procSkipLine(p);
+    }
+
+    snapshot->count = rows;
+    snapshot->timestampNs = monotonicNs();
+}
+
+// Row of name in prev: the same row unless devices were added or removed; -1 if absent
+static int matchDevice(const DiskSnapshot *prev, const char *name, int row) {
+    if (row < prev->count && strcmp(prev->name[row], name) == 0)
+        return row;
+    for (int i = 0; i < prev->count; i++)
+        if (strcmp(prev->name[i], name) == 0)
+            return i;
+    return -1;
+}
+
+// Growth of a counter; a counter that went backwards (device re-registered, 32-bit wrap) counts as 0
+static double counterDelta(uint64_t curr, uint64_t prev) {
+    return curr < prev ? 0.0 : (double)(curr - prev);
+}
+
+// Computes per-device IOPS, throughput, queue depth and utilisation between two snapshots
+void calculateDiskRates(const DiskSnapshot *prev, const DiskSnapshot *curr, DiskSample *sample) {
+    double seconds = (curr->timestampNs - prev->timestampNs) / 1e9;
+    double ms = seconds * 1000.0;
+    int count = 0;
+
+    sample->intervalNs = curr->timestampNs - prev->timestampNs;
+    sample->total = curr->count;
+
+    for (int i = 0; i < curr->count; i++) {
+        if (curr->reads[i] == 0 && curr->writes[i] == 0)
+            continue;
+
+        int j = matchDevice(prev, curr->name[i], i);
+        memcpy(sample->name[count], curr->name[i], DISK_NAME_LEN);
+
+        if (j == -1 || seconds <= 0) {
+            sample->readIops[count] = sample->writeIops[count] = 0.0f;
+            sample->readKBps[count] = sample->writeKBps[count] = 0.0f;
+            sample->queue[count] = sample->util[count] = 0.0f;
+        } else {
+            // Sectors are always 512 bytes in /proc/diskstats
+            sample->readIops[count] = counterDelta(curr->reads[i], prev->reads[j]) / seconds;
+            sample->writeIops[count] = counterDelta(curr->writes[i], prev->writes[j]) / seconds;
+            sample->readKBps[count] = counterDelta(curr->readSectors[i], prev->readSectors[j]) / 2.0 / seconds;
+            sample->writeKBps[count] = counterDelta(curr->writeSectors[i], prev->writeSectors[j]) / 2.0 / seconds;
+            sample->queue[count] = counterDelta(curr->weightedMs[i], prev->weightedMs[j]) / ms;
+            double util = counterDelta(curr->ioMs[i], prev->ioMs[j]) / ms * 100.0;
+            sample->util[count] = util > 100.0 ? 100.0f : (float)util;
+        }
+        count++;
+    }
+
+    sample->count = count;
+}
+
+// Takes a baseline on tick 0, then pushes the rates of every interval
+void storeDiskSamples(SampleClock *clock, SampleRing *diskRing) {
+    collectorRun("disk", clock, diskRing);
+}
+
+static int diskCollectorInit(void *state) {
+    return diskInit(state);
+}
+
+static int diskCollectorSample(void *state, void *out) {
+    storeDiskArr(state, out);
+    return 0;
+}
+
+static void diskCollectorDiff(void *state, const void *prev, const void *curr, void *out) {
+    DiskSample *sample = out;
+
+    (void)state;
+    calculateDiskRates(prev, curr, sample);
+    sample->header.timestampNs = ((const DiskSnapshot *)curr)->timestampNs;
+}
+
+static void diskCollectorTeardown(void *state) {
+    diskFree(state);
+}
+
+const CollectorOps diskCollector = {
+    .name = "disk", .stateSize = sizeof(DiskCollector), .snapshotSize = sizeof(DiskSnapshot),
+    .sampleSize = sizeof(DiskSample), .latencyPhase = LAT_COLLECT_DISK, .init = diskCollectorInit,
+    .sample = diskCollectorSample, .diff = diskCollectorDiff, .teardown = diskCollectorTeardown,
+};
+
+// Prints the per-device table of the last interval
+void printDisks(const DiskSample *sample) {
+    renderf("### Disks ### (%d devices, %d with I/O)\n", sample->total, sample->count);
+    renderf(" device              r/s      w/s    rKB/s    wKB/s  queue  util%%\n");
+
+    for (int i = 0; i < sample->count && i < DISK_SHOWN; i++)
+        renderf(" %-15s %8.1f %8.1f %8.1f %8.1f %6.2f %6.1f\n", sample->name[i],
+                sample->readIops[i], sample->writeIops[i], sample->readKBps[i], sample->writeKBps[i],
+                sample->queue[i], sample->util[i]);
+
+    if (sample->count > DISK_SHOWN)
+        renderf(" ... %d more\n", sample->count - DISK_SHOWN);
+}
@@ -0,0 +1,48 @@
+#ifndef DISKSTATS_H
+#define DISKSTATS_H
+
+#include "stats_functions.h"
+
+#define MAX_DISKS 512
+#define DISK_NAME_LEN 32
+#define DISK_SHOWN 16               // table rows drawn per frame
+#define DISKSTATS_BUFSIZE (256 * 1024)
+
+// Raw /proc/diskstats counters, one row per device in file order
+typedef struct {
+    uint64_t timestampNs;
+    int count;
+    char name[MAX_DISKS][DISK_NAME_LEN];
+    uint64_t reads[MAX_DISKS], readSectors[MAX_DISKS];
+    uint64_t writes[MAX_DISKS], writeSectors[MAX_DISKS];
+    uint64_t ioMs[MAX_DISKS], weightedMs[MAX_DISKS];
+} DiskSnapshot;
+
+// State of the disk collector: /proc/diskstats kept open between snapshots
+typedef struct {
+    ProcFile diskstats;
+    char buf[DISKSTATS_BUFSIZE];
+} DiskCollector;
+
+// Per-device rates over one interval; devices that never did I/O are left out
+typedef struct {
+    SampleHeader header;
+    uint64_t intervalNs;
+    int count;
+    int total;                      // devices listed in /proc/diskstats
+    char name[MAX_DISKS][DISK_NAME_LEN];
+    float readIops[MAX_DISKS], writeIops[MAX_DISKS];
+    float readKBps[MAX_DISKS], writeKBps[MAX_DISKS];
+    float queue[MAX_DISKS];         // average requests in flight
+    float util[MAX_DISKS];          // % of the interval the device was busy
+} DiskSample;
+
+// Function prototypes
+int diskInit(DiskCollector *disk);
+void storeDiskArr(DiskCollector *disk, DiskSnapshot *snapshot);
+void diskFree(DiskCollector *disk);
+void calculateDiskRates(const DiskSnapshot *prev, const DiskSnapshot *curr, DiskSample *sample);
+void storeDiskSamples(SampleClock *clock, SampleRing *diskRing);
+void printDisks(const DiskSample *sample);
+
+#endif // DISKSTATS_H
@@ -0,0 +1,223 @@
+#define _GNU_SOURCE
+
+#include "exporter.h"
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/time.h>
+
+#define GB_TO_BYTES (1024.0 * 1024 * 1024)
+
+// Accepts scrapers and answers each with the pre-serialized front buffer
+static void *exporterServe(void *arg) {
+    Exporter *exporter = arg;
+    char request[1024];
+
+    for (;;) {
+        int fd = accept4(exporter->listenFd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;  // listening socket closed
+        }
+
+        // Consume the request head (bounded by a short timeout); the answer never depends on it
+        struct timeval timeout = { .tv_sec = 0, .tv_usec = 100000 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        size_t got = 0;
+        ssize_t n;
+        while (got < sizeof(request) - 1 && (n = recv(fd, request + got, sizeof(request) - 1 - got, 0)) > 0) {
+            got += n;
+            request[got] = '\0';
+            if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n"))
+                break;
+        }
+
+        // Pin the front buffer, then write with the lock released: a stalled
+        // scraper holds up only this thread, and at most for the send timeout
+        pthread_mutex_lock(&exporter->lock);
+        exporter->serving = exporter->front;
+        const char *out = exporter->buffers[exporter->serving] + exporter->frontOffset;
+        size_t left = exporter->frontLen;
+        pthread_mutex_unlock(&exporter->lock);
+
+        struct timeval sendTimeout = { .tv_sec = 1, .tv_usec = 0 };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+        while (left > 0 && (n = send(fd, out, left, MSG_NOSIGNAL)) > 0) {
+            out += n;
+            left -= n;
+        }   // an error or timeout just drops this scraper
+
+        pthread_mutex_lock(&exporter->lock);
+        exporter->serving = -1;
+        pthread_mutex_unlock(&exporter->lock);
+        close(fd);
+    }
+    return NULL;
+}
+
+// Binds path (replacing a stale socket, never any other kind of file) and starts the serving thread
+int exporterOpen(Exporter *exporter, const char *path) {
+    struct sockaddr_un addr;
+    struct stat st;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            errno = EEXIST;     // a mistyped path must not delete a regular file
+            return -1;
+        }
+        unlink(path);
+    }
+
+    exporter->path = path;
+    exporter->front = 0;
+    exporter->serving = -1;
+    exporter->frontOffset = 0;
+    exporter->frontLen = snprintf(exporter->buffers[0], EXPORT_BUFSIZE,
+                                  "HTTP/1.0 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n");
+    pthread_mutex_init(&exporter->lock, NULL);
+
+    exporter->listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (exporter->listenFd == -1 ||
+        bind(exporter->listenFd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(exporter->listenFd, 128) == -1) {
+        int saved = errno;
+        if (exporter->listenFd != -1)
+            close(exporter->listenFd);
+        pthread_mutex_destroy(&exporter->lock);
+        errno = saved;
+        return -1;
+    }
+
+    // The serving thread must never run the Ctrl-C handler
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    int err = pthread_create(&exporter->thread, NULL, exporterServe, exporter);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (err) {
+        close(exporter->listenFd);
+        unlink(path);
+        pthread_mutex_destroy(&exporter->lock);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+// Appends one labelled CPU series for every row of the sample
+static size_t exportCpuSeries(char *out, size_t size, const char *name, const char *help,
+                              const CpuSample *cpu, const float *values) {
+    size_t len = snprintf(out, size, "# HELP %s %s\n# TYPE %s gauge\n", name, help, name);
+
+    for (int i = 0; i < cpu->rows && len < size; i++) {
+        if (i == 0)
+            len += snprintf(out + len, size - len, "%s{cpu=\"all\"} %.2f\n", name, values[i]);
+        else
+            len += snprintf(out + len, size - len, "%s{cpu=\"%d\"} %.2f\n", name, cpu->cpuId[i], values[i]);
+    }
+    return len;
+}
+
+// Serializes the snapshot of this tick once and makes it the served response
+void exporterPublish(Exporter *exporter, const MemSample *mem, const CpuSample *cpu, int sessions) {
+    enum { HEADER_ROOM = 128 };
+
+    // Fill the buffer that is neither the current response nor being written out
+    pthread_mutex_lock(&exporter->lock);
+    int next = 0;
+    while (next == exporter->front || next == exporter->serving)
+        next++;
+    pthread_mutex_unlock(&exporter->lock);
+
+    char *back = exporter->buffers[next];
+    char *body = back + HEADER_ROOM;
+    size_t size = EXPORT_BUFSIZE - HEADER_ROOM, len = 0;
+
+    if (mem) {
+        len += snprintf(body + len, size - len,
+                        "# HELP sysstats_memory_used_bytes Physical memory in use (total minus MemAvailable).\n"
+                        "# TYPE sysstats_memory_used_bytes gauge\n"
+                        "sysstats_memory_used_bytes %.0f\n"
+                        "# HELP sysstats_memory_total_bytes Physical memory installed.\n"
+                        "# TYPE sysstats_memory_total_bytes gauge\n"
+                        "sysstats_memory_total_bytes %.0f\n"
+                        "# HELP sysstats_virtual_memory_used_bytes Physical plus swap memory in use.\n"
+                        "# TYPE sysstats_virtual_memory_used_bytes gauge\n"
+                        "sysstats_virtual_memory_used_bytes %.0f\n"
+                        "# HELP sysstats_virtual_memory_total_bytes Physical plus swap memory available.\n"
+                        "# TYPE sysstats_virtual_memory_total_bytes gauge\n"
+                        "sysstats_virtual_memory_total_bytes %.0f\n",
+                        mem->physUsedGb * GB_TO_BYTES, mem->physTotalGb * GB_TO_BYTES,
+                        mem->virtUsedGb * GB_TO_BYTES, mem->virtTotalGb * GB_TO_BYTES);
+    }
+
+    if (mem && mem->detailed && len < size) {
+        len += snprintf(body + len, size - len,
+                        "# HELP sysstats_memory_available_bytes MemAvailable from /proc/meminfo.\n"
+                        "# TYPE sysstats_memory_available_bytes gauge\n"
+                        "sysstats_memory_available_bytes %.0f\n"
+                        "# HELP sysstats_memory_cached_bytes Page cache (Cached) from /proc/meminfo.\n"
+                        "# TYPE sysstats_memory_cached_bytes gauge\n"
+                        "sysstats_memory_cached_bytes %.0f\n"
+                        "# HELP sysstats_memory_dirty_bytes Dirty page cache waiting for writeback.\n"
+                        "# TYPE sysstats_memory_dirty_bytes gauge\n"
+                        "sysstats_memory_dirty_bytes %.0f\n",
+                        mem->availGb * GB_TO_BYTES, mem->cachedGb * GB_TO_BYTES, mem->dirtyGb * GB_TO_BYTES);
+    }
+
+    if (cpu && len < size) {
+        len += exportCpuSeries(body + len, size - len, "sysstats_cpu_busy_percent",
+                               "CPU time not idle or waiting on I/O over the last interval.", cpu, cpu->busy);
+        if (len < size)
+            len += exportCpuSeries(body + len, size - len, "sysstats_cpu_iowait_percent",
+                                   "CPU time waiting on I/O over the last interval.", cpu, cpu->iowait);
+        if (len < size)
+            len += exportCpuSeries(body + len, size - len, "sysstats_cpu_steal_percent",
+                                   "CPU time stolen by the hypervisor over the last interval.", cpu, cpu->steal);
+        if (len < size)
+            len += exportCpuSeries(body + len, size - len, "sysstats_cpu_irq_percent",
+                                   "CPU time in hard and soft interrupts over the last interval.", cpu, cpu->irq);
+    }
+
+    if (len < size) {
+        len += snprintf(body + len, size - len,
+                        "# HELP sysstats_sessions Logged-in user sessions.\n"
+                        "# TYPE sysstats_sessions gauge\n"
+                        "sysstats_sessions %d\n", sessions);
+    }
+    if (len >= size)
+        len = size - 1;
+
+    // Right-align the HTTP header against the body so the response is contiguous
+    char header[HEADER_ROOM];
+    int headerLen = snprintf(header, sizeof(header),
+                             "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                             "Content-Length: %zu\r\n\r\n", len);
+    char *start = body - headerLen;
+    memcpy(start, header, headerLen);
+
+    pthread_mutex_lock(&exporter->lock);
+    exporter->front = next;
+    exporter->frontOffset = start - back;
+    exporter->frontLen = headerLen + len;
+    pthread_mutex_unlock(&exporter->lock);
+}
+
+// Stops serving and removes the socket file
+void exporterClose(Exporter *exporter) {
+    shutdown(exporter->listenFd, SHUT_RDWR);
+    close(exporter->listenFd);
+    pthread_join(exporter->thread, NULL);
+    unlink(exporter->path);
+}
@@ -0,0 +1,30 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <pthread.h>
+#include "stats_functions.h"
+
+#define EXPORT_BUFSIZE (256 * 1024)
+
+// Serves the latest snapshot in Prometheus text format on a Unix socket.
+// The response is serialized once per tick into a back buffer and swapped
+// in, so each scrape costs one accept() and one write(). There are three
+// buffers so the one a slow scraper is still reading is never refilled:
+// the lock only guards the indexes, never a write to a socket.
+typedef struct {
+    int listenFd;
+    const char *path;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    int front;                  // latest complete response
+    int serving;                // buffer the serving thread is writing out, or -1
+    size_t frontOffset, frontLen;
+    char buffers[3][EXPORT_BUFSIZE];
+} Exporter;
+
+// Function prototypes
+int exporterOpen(Exporter *exporter, const char *path);
+void exporterPublish(Exporter *exporter, const MemSample *mem, const CpuSample *cpu, int sessions);
+void exporterClose(Exporter *exporter);
+
+#endif // EXPORTER_H
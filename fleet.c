@@ -0,0 +1,400 @@
+#define _GNU_SOURCE
+
+#include "fleet.h"
+#include <errno.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#define FLEET_EVENTS 256
+#define FLEET_RETRY_NS 1000000000ull
+
+// Resolves "unix:/path", "/path" or "host:port" (host may be empty when listening)
+static int fleetAddress(const char *address, int listening, struct sockaddr_storage *addr, socklen_t *len) {
+    memset(addr, 0, sizeof(*addr));
+
+    if (strncmp(address, "unix:", 5) == 0)
+        address += 5;
+    if (strchr(address, '/')) {
+        struct sockaddr_un *un = (struct sockaddr_un *)addr;
+        if (strlen(address) >= sizeof(un->sun_path)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, address);
+        *len = sizeof(*un);
+        return 0;
+    }
+
+    const char *colon = strrchr(address, ':');
+    char host[256];
+    struct addrinfo hints, *result;
+
+    if (!colon || (size_t)(colon - address) >= sizeof(host)) {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(host, address, colon - address);
+    host[colon - address] = '\0';
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    if (getaddrinfo(host[0] ? host : NULL, colon + 1, &hints, &result) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(addr, result->ai_addr, result->ai_addrlen);
+    *len = result->ai_addrlen;
+    freeaddrinfo(result);
+    return 0;
+}
+
+// Connects to the aggregator and introduces this host; returns -1 if it is not reachable
+static int fleetConnect(FleetAgent *agent) {
+    struct sockaddr_storage addr;
+    socklen_t len;
+    FleetFrame frame = { FLEET_MAGIC, FLEET_VERSION, FLEET_HELLO, 1, sizeof(FleetHello) };
+
+    if (fleetAddress(agent->address, 0, &addr, &len) == -1)
+        return -1;
+
+    int fd = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return -1;
+
+    // A stalled aggregator must not stall the sampling loop for long (also bounds connect)
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = 100000 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    struct iovec parts[2] = { { &frame, sizeof(frame) }, { &agent->hello, sizeof(agent->hello) } };
+    struct msghdr msg = { .msg_iov = parts, .msg_iovlen = 2 };
+    if (connect(fd, (struct sockaddr *)&addr, len) == -1 ||
+        sendmsg(fd, &msg, MSG_NOSIGNAL) != (ssize_t)(sizeof(frame) + sizeof(agent->hello))) {
+        close(fd);
+        return -1;
+    }
+    agent->fd = fd;
+    return 0;
+}
+
+// Prepares the HELLO and makes a first connection attempt (a missing aggregator is retried later)
+int fleetAgentOpen(FleetAgent *agent, const char *address, const char *name, uint64_t intervalNs) {
+    struct sockaddr_storage addr;
+    socklen_t len;
+
+    memset(agent, 0, sizeof(FleetAgent));
+    if (fleetAddress(address, 0, &addr, &len) == -1)
+        return -1;
+
+    agent->address = address;
+    agent->fd = -1;
+    if (name)
+        snprintf(agent->hello.name, sizeof(agent->hello.name), "%s", name);
+    else if (gethostname(agent->hello.name, sizeof(agent->hello.name) - 1) == -1)
+        strcpy(agent->hello.name, "unknown");
+    agent->hello.intervalNs = intervalNs;
+    agent->hello.cores = sysconf(_SC_NPROCESSORS_ONLN);
+    agent->batch.frame = (FleetFrame){ FLEET_MAGIC, FLEET_VERSION, FLEET_SAMPLES, 0, 0 };
+
+    if (fleetConnect(agent) == -1)
+        agent->retryNs = monotonicNs() + FLEET_RETRY_NS;
+    return 0;
+}
+
+// Sends the buffered batch in one send(); samples that cannot be delivered are counted as dropped
+static void fleetFlush(FleetAgent *agent, uint64_t now) {
+    FleetFrame *frame = &agent->batch.frame;
+    size_t size = sizeof(FleetFrame) + frame->count * sizeof(FleetSample);
+
+    if (agent->fd == -1 && now >= agent->retryNs && fleetConnect(agent) == -1)
+        agent->retryNs = now + FLEET_RETRY_NS;
+
+    frame->bytes = frame->count * sizeof(FleetSample);
+    if (agent->fd != -1 && send(agent->fd, &agent->batch, size, MSG_NOSIGNAL) == (ssize_t)size)
+        agent->sent += frame->count;
+    else {
+        if (agent->fd != -1) {
+            close(agent->fd);
+            agent->fd = -1;
+            agent->retryNs = now + FLEET_RETRY_NS;
+        }
+        agent->dropped += frame->count;
+    }
+    frame->count = 0;
+}
+
+// Queues the samples of one tick; flushes when the batch is full or its oldest sample is FLEET_FLUSH_NS old
+void fleetAgentPush(FleetAgent *agent, const MemSample *mem, const CpuSample *cpu, int sessions) {
+    FleetFrame *frame = &agent->batch.frame;
+    FleetSample *sample = &agent->batch.samples[frame->count];
+    uint64_t now = monotonicNs();
+
+    memset(sample, 0, sizeof(FleetSample));
+    sample->timestampNs = mem ? mem->header.timestampNs : cpu ? cpu->header.timestampNs : now;
+    sample->tick = mem ? mem->header.tick : cpu ? cpu->header.tick : 0;
+    sample->sessions = sessions;
+    if (mem) {
+        sample->physUsedGb = mem->physUsedGb;
+        sample->physTotalGb = mem->physTotalGb;
+        sample->virtUsedGb = mem->virtUsedGb;
+        sample->virtTotalGb = mem->virtTotalGb;
+    }
+    if (cpu) {
+        sample->cpuBusy = cpu->busy[0];
+        sample->cpuIowait = cpu->iowait[0];
+        sample->cpuSteal = cpu->steal[0];
+        sample->cpuIrq = cpu->irq[0];
+    }
+
+    if (frame->count++ == 0)
+        agent->firstNs = now;
+    if (frame->count == FLEET_BATCH || now - agent->firstNs >= FLEET_FLUSH_NS)
+        fleetFlush(agent, now);
+}
+
+// Sends what is still buffered and disconnects
+void fleetAgentClose(FleetAgent *agent) {
+    if (agent->batch.frame.count > 0)
+        fleetFlush(agent, monotonicNs());
+    if (agent->fd != -1)
+        close(agent->fd);
+    agent->fd = -1;
+}
+
+// Listens on address and watches the listener and the render timer on one epoll set
+int fleetAggregatorOpen(FleetAggregator *fleet, const char *address, int timerFd) {
+    struct sockaddr_storage addr;
+    socklen_t len;
+    int one = 1;
+
+    memset(fleet, 0, sizeof(FleetAggregator));
+    fleet->listenFd = fleet->epollFd = -1;
+    fleet->timerFd = timerFd;
+    if (fleetAddress(address, 1, &addr, &len) == -1)
+        return -1;
+
+    procRaiseFdLimit();     // so one aggregator can hold thousands of agents
+    if (addr.ss_family == AF_UNIX) {
+        fleet->path = strncmp(address, "unix:", 5) == 0 ? address + 5 : address;   // outlives addr
+        unlink(fleet->path);
+    }
+
+    fleet->listenFd = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fleet->listenFd == -1)
+        return -1;
+    setsockopt(fleet->listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fleet->listenFd, (struct sockaddr *)&addr, len) == -1 || listen(fleet->listenFd, 4096) == -1)
+        return -1;
+
+    fleet->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = &fleet->listenFd };
+    if (fleet->epollFd == -1 || epoll_ctl(fleet->epollFd, EPOLL_CTL_ADD, fleet->listenFd, &event) == -1)
+        return -1;
+    event.data.ptr = &fleet->timerFd;
+    return epoll_ctl(fleet->epollFd, EPOLL_CTL_ADD, timerFd, &event);
+}
+
+// Finds the host of a HELLO by name (a reconnecting agent keeps its row) or adds it
+static int fleetHost(FleetAggregator *fleet, const FleetHello *hello) {
+    char name[FLEET_NAME_LEN];
+    int h;
+
+    memcpy(name, hello->name, sizeof(name));
+    name[sizeof(name) - 1] = '\0';
+
+    for (h = 0; h < fleet->hostCount; h++)
+        if (strcmp(fleet->hosts[h].name, name) == 0)
+            break;
+    if (h == fleet->hostCount) {
+        if (h == FLEET_MAX_HOSTS)
+            return -1;
+        memset(&fleet->hosts[h], 0, sizeof(FleetHost));
+        memcpy(fleet->hosts[h].name, name, sizeof(name));
+        fleet->hostCount++;
+    }
+
+    fleet->hosts[h].intervalNs = hello->intervalNs;
+    fleet->hosts[h].cores = hello->cores;
+    fleet->hosts[h].connected++;
+    return h;
+}
+
+static void fleetDrop(FleetAggregator *fleet, FleetConn *conn) {
+    if (conn->host >= 0)
+        fleet->hosts[conn->host].connected--;
+    close(conn->fd);    // also removes it from the epoll set
+    fleet->connections--;
+    free(conn);
+}
+
+// Consumes the complete frames in a connection buffer; returns -1 on a protocol error
+static int fleetParse(FleetAggregator *fleet, FleetConn *conn, uint64_t now) {
+    size_t used = 0;
+
+    while (conn->have - used >= sizeof(FleetFrame)) {
+        FleetFrame frame;
+        memcpy(&frame, conn->buf + used, sizeof(frame));
+        if (frame.magic != FLEET_MAGIC || frame.version != FLEET_VERSION ||
+            frame.bytes > FLEET_CONN_BUFSIZE - sizeof(FleetFrame))
+            return -1;
+        if (conn->have - used < sizeof(FleetFrame) + frame.bytes)
+            break;
+
+        const unsigned char *payload = conn->buf + used + sizeof(FleetFrame);
+        if (frame.type == FLEET_HELLO && frame.bytes == sizeof(FleetHello) && conn->host == -1) {
+            FleetHello hello;
+            memcpy(&hello, payload, sizeof(hello));
+            if ((conn->host = fleetHost(fleet, &hello)) == -1)
+                return -1;
+        } else if (frame.type == FLEET_SAMPLES && conn->host >= 0 && frame.count > 0 &&
+                   frame.bytes == frame.count * sizeof(FleetSample)) {
+            FleetHost *host = &fleet->hosts[conn->host];
+            memcpy(&host->latest, payload + (frame.count - 1) * sizeof(FleetSample), sizeof(FleetSample));
+            host->receivedNs = now;
+            host->samples += frame.count;
+            fleet->samples += frame.count;
+        } else
+            return -1;
+
+        fleet->messages++;
+        used += sizeof(FleetFrame) + frame.bytes;
+    }
+
+    memmove(conn->buf, conn->buf + used, conn->have - used);
+    conn->have -= used;
+    return 0;
+}
+
+// Accepts every pending agent
+static void fleetAccept(FleetAggregator *fleet) {
+    for (;;) {
+        int fd = accept4(fleet->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1)
+            return;     // EAGAIN, or out of descriptors until an agent leaves
+
+        FleetConn *conn = malloc(sizeof(FleetConn));
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = conn };
+        if (!conn || epoll_ctl(fleet->epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+            free(conn);
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        conn->host = -1;
+        conn->have = 0;
+        fleet->connections++;
+    }
+}
+
+// Handles agent traffic until the render timer fires; returns its expirations (0 if interrupted)
+uint64_t fleetAggregatorServe(FleetAggregator *fleet) {
+    struct epoll_event events[FLEET_EVENTS];
+    uint64_t expirations = 0;
+
+    while (expirations == 0) {
+        int n = epoll_wait(fleet->epollFd, events, FLEET_EVENTS, -1);
+        if (n == -1)
+            return 0;   // interrupted by Ctrl-C
+
+        uint64_t now = monotonicNs();
+        for (int i = 0; i < n; i++) {
+            void *ptr = events[i].data.ptr;
+
+            if (ptr == &fleet->listenFd)
+                fleetAccept(fleet);
+            else if (ptr == &fleet->timerFd) {
+                if (read(fleet->timerFd, &expirations, sizeof(expirations)) != sizeof(expirations))
+                    expirations = 0;
+            } else {
+                FleetConn *conn = ptr;
+                ssize_t got = read(conn->fd, conn->buf + conn->have, FLEET_CONN_BUFSIZE - conn->have);
+                if (got == -1 && (errno == EAGAIN || errno == EINTR))
+                    continue;
+                if (got <= 0) {
+                    fleetDrop(fleet, conn);
+                    continue;
+                }
+                conn->have += got;
+                if (fleetParse(fleet, conn, now) == -1)
+                    fleetDrop(fleet, conn);
+            }
+        }
+    }
+    return expirations;
+}
+
+static int compareFloats(const void *a, const void *b) {
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts (cpu, host) pairs busiest first
+static int compareBusiest(const void *a, const void *b) {
+    const float *x = a, *y = b;
+    return (x[0] < y[0]) - (x[0] > y[0]);
+}
+
+static float percentileOf(const float *sorted, int count, double p) {
+    int index = (int)(p * (count - 1) + 0.5);
+    return count > 0 ? sorted[index] : 0.0f;
+}
+
+// Prints fleet-wide percentiles over the hosts reporting on time, then the busiest hosts
+void printFleet(const FleetAggregator *fleet) {
+    static float cpu[FLEET_MAX_HOSTS], mem[FLEET_MAX_HOSTS], busiest[FLEET_MAX_HOSTS][2];
+    uint64_t now = monotonicNs();
+    int fresh = 0, connected = 0;
+
+    for (int h = 0; h < fleet->hostCount; h++) {
+        const FleetHost *host = &fleet->hosts[h];
+        connected += host->connected > 0;
+        if (host->samples == 0 || now - host->receivedNs > FLEET_STALE_TICKS * host->intervalNs + FLEET_FLUSH_NS)
+            continue;
+        cpu[fresh] = host->latest.cpuBusy;
+        mem[fresh] = host->latest.physTotalGb > 0 ? host->latest.physUsedGb / host->latest.physTotalGb * 100 : 0;
+        busiest[fresh][0] = host->latest.cpuBusy;
+        busiest[fresh][1] = (float)h;
+        fresh++;
+    }
+
+    qsort(cpu, fresh, sizeof(float), compareFloats);
+    qsort(mem, fresh, sizeof(float), compareFloats);
+    qsort(busiest, fresh, sizeof(busiest[0]), compareBusiest);
+
+    renderf("### Fleet ### %d host(s), %d connected, %d reporting; %llu samples in %llu messages\n",
+            fleet->hostCount, connected, fresh, (unsigned long long)fleet->samples,
+            (unsigned long long)fleet->messages);
+    renderf("             p50     p90     p99     max\n");
+    renderf(" cpu %%   %7.2f %7.2f %7.2f %7.2f\n", percentileOf(cpu, fresh, 0.50), percentileOf(cpu, fresh, 0.90),
+            percentileOf(cpu, fresh, 0.99), percentileOf(cpu, fresh, 1.0));
+    renderf(" mem %%   %7.2f %7.2f %7.2f %7.2f\n", percentileOf(mem, fresh, 0.50), percentileOf(mem, fresh, 0.90),
+            percentileOf(mem, fresh, 0.99), percentileOf(mem, fresh, 1.0));
+    renderf("---------------------------------------\n");
+    renderf("HOST                        CPU%%  IOWAIT%%      MEM GB   SESS     AGE\n");
+
+    for (int i = 0; i < fresh && i < FLEET_SHOWN; i++) {
+        const FleetHost *host = &fleet->hosts[(int)busiest[i][1]];
+        renderf("%-24.24s %7.2f %8.2f %5.2f/%-6.2f %4u %6.1fs\n", host->name, host->latest.cpuBusy,
+                host->latest.cpuIowait, host->latest.physUsedGb, host->latest.physTotalGb, host->latest.sessions,
+                (now - host->receivedNs) / 1e9);
+    }
+    if (fresh > FLEET_SHOWN)
+        renderf("... and %d more host(s)\n", fresh - FLEET_SHOWN);
+    if (fleet->hostCount > fresh)
+        renderf("%d host(s) stale or disconnected\n", fleet->hostCount - fresh);
+}
+
+// Stops listening and removes the Unix socket
+void fleetAggregatorClose(FleetAggregator *fleet) {
+    if (fleet->listenFd != -1)
+        close(fleet->listenFd);
+    if (fleet->epollFd != -1)
+        close(fleet->epollFd);
+    if (fleet->path)
+        unlink(fleet->path);
+}
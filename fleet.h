@@ -0,0 +1,93 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include "stats_functions.h"
+
+#define FLEET_MAGIC 0x54454c46u     // "FLET"
+#define FLEET_VERSION 1
+#define FLEET_BATCH 16              // samples per message at most
+#define FLEET_FLUSH_NS 1000000000ull    // a partial batch is sent once its oldest sample is this old
+#define FLEET_NAME_LEN 64
+#define FLEET_MAX_HOSTS 4096
+#define FLEET_CONN_BUFSIZE 8192
+#define FLEET_SHOWN 20              // busiest hosts listed in the fleet view
+#define FLEET_STALE_TICKS 3         // a host is stale after this many of its intervals without data
+
+enum { FLEET_HELLO = 1, FLEET_SAMPLES = 2 };
+
+// Wire format: a FleetFrame followed by `bytes` of payload (one FleetHello, or
+// `count` FleetSamples). Fields are in host byte order: agents and aggregator
+// are expected to share an architecture.
+typedef struct {
+    uint32_t magic;
+    uint16_t version, type;
+    uint32_t count;
+    uint32_t bytes;
+} FleetFrame;
+
+typedef struct {
+    char name[FLEET_NAME_LEN];
+    uint64_t intervalNs;
+    uint32_t cores;
+    uint32_t reserved;
+} FleetHello;
+
+// The per-tick numbers of MemSample, the aggregate CpuSample row and the session count
+typedef struct {
+    uint64_t timestampNs;       // agent's CLOCK_MONOTONIC
+    uint32_t tick, sessions;
+    float physUsedGb, physTotalGb, virtUsedGb, virtTotalGb;
+    float cpuBusy, cpuIowait, cpuSteal, cpuIrq;
+} FleetSample;
+
+// Streams samples to an aggregator in batches; reconnects on the next flush after a failure
+typedef struct {
+    const char *address;
+    int fd;                     // -1 while disconnected
+    FleetHello hello;
+    uint64_t firstNs;           // when the oldest buffered sample was queued
+    uint64_t retryNs;           // next connection attempt while disconnected
+    uint64_t sent, dropped;
+    struct {
+        FleetFrame frame;
+        FleetSample samples[FLEET_BATCH];
+    } batch;                    // contiguous, so a flush is one send()
+} FleetAgent;
+
+typedef struct {
+    char name[FLEET_NAME_LEN];
+    FleetSample latest;
+    uint64_t receivedNs;        // aggregator clock when latest arrived
+    uint64_t intervalNs;
+    uint64_t samples;
+    uint32_t cores;
+    int connected;
+} FleetHost;
+
+typedef struct {
+    int fd;
+    int host;                   // -1 until the HELLO arrived
+    size_t have;
+    unsigned char buf[FLEET_CONN_BUFSIZE];
+} FleetConn;
+
+// Merges many agent streams on one epoll loop
+typedef struct {
+    int listenFd, epollFd, timerFd;
+    const char *path;           // Unix socket to remove on close, NULL for TCP
+    int hostCount, connections;
+    uint64_t messages, samples;
+    FleetHost hosts[FLEET_MAX_HOSTS];
+} FleetAggregator;
+
+// Function prototypes
+int fleetAgentOpen(FleetAgent *agent, const char *address, const char *name, uint64_t intervalNs);
+void fleetAgentPush(FleetAgent *agent, const MemSample *mem, const CpuSample *cpu, int sessions);
+void fleetAgentClose(FleetAgent *agent);
+
+int fleetAggregatorOpen(FleetAggregator *fleet, const char *address, int timerFd);
+uint64_t fleetAggregatorServe(FleetAggregator *fleet);
+void printFleet(const FleetAggregator *fleet);
+void fleetAggregatorClose(FleetAggregator *fleet);
+
+#endif // FLEET_H
@@ -0,0 +1,158 @@
+#define _GNU_SOURCE
+
+#include "frame.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+typedef struct {
+    char text[FRAME_BUFSIZE];
+    size_t len;
+    int lineCount;
+    int firstVisible;           // lines above it scrolled off the terminal
+    size_t lineStart[FRAME_MAX_LINES + 1];
+} Frame;
+
+static Frame frames[2];
+static int current;                     // frame being filled; the other one is on screen
+static int diffMode;
+static volatile sig_atomic_t onScreen;  // the other frame matches the terminal
+static unsigned short screenRows, screenCols;
+static char out[FRAME_BUFSIZE + FRAME_MAX_LINES * 24 + 64];
+
+// Starts a new frame; diff enables cursor-addressed updates against the previous frame
+void frameBegin(int diff) {
+    diffMode = diff;
+    frames[current].len = 0;
+}
+
+// Appends formatted text to the current frame; text past FRAME_BUFSIZE is dropped
+void renderf(const char *format, ...) {
+    Frame *frame = &frames[current];
+    size_t room = sizeof(frame->text) - frame->len;
+    va_list args;
+
+    if (room <= 1)
+        return;
+
+    va_start(args, format);
+    int n = vsnprintf(frame->text + frame->len, room, format, args);
+    va_end(args);
+
+    if (n > 0)
+        frame->len += (size_t)n < room ? (size_t)n : room - 1;
+}
+
+// Forces the next frame to be drawn in full (e.g. after something else wrote to the terminal)
+void frameInvalidate(void) {
+    onScreen = 0;
+}
+
+// Records where each line of a frame starts
+static void splitLines(Frame *frame) {
+    size_t pos = 0;
+
+    frame->lineCount = 0;
+    while (pos < frame->len && frame->lineCount < FRAME_MAX_LINES) {
+        frame->lineStart[frame->lineCount++] = pos;
+        const char *nl = memchr(frame->text + pos, '\n', frame->len - pos);
+        pos = nl ? (size_t)(nl - frame->text) + 1 : frame->len;
+    }
+    frame->lineStart[frame->lineCount] = pos;
+}
+
+// Length of a line without its newline
+static size_t lineLength(const Frame *frame, int line) {
+    size_t len = frame->lineStart[line + 1] - frame->lineStart[line];
+    if (len > 0 && frame->text[frame->lineStart[line] + len - 1] == '\n')
+        len--;
+    return len;
+}
+
+// Writes the whole buffer, resuming after partial writes and signals
+static void writeAll(const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, buf, len);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+// Emits the current frame and makes it the one on screen
+void frameEnd(void) {
+    Frame *frame = &frames[current], *prev = &frames[current ^ 1];
+    struct winsize size;
+    size_t len = 0;
+
+    // Anything printed through stdio so far must reach the terminal first
+    fflush(stdout);
+
+    if (!diffMode) {
+        writeAll(frame->text, frame->len);
+        onScreen = 0;
+        return;
+    }
+
+    splitLines(frame);
+
+    unsigned short rows = 0, cols = 0;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0) {
+        rows = size.ws_row;
+        cols = size.ws_col;
+    }
+    if (rows != screenRows || cols != screenCols) {
+        screenRows = rows;
+        screenCols = cols;
+        onScreen = 0;
+    }
+
+    // Like a scrolling terminal, keep the bottom of a frame taller than the screen
+    // and leave the last row for the cursor
+    frame->firstVisible = rows > 1 && frame->lineCount > rows - 1 ? frame->lineCount - (rows - 1) : 0;
+    int visible = frame->lineCount - frame->firstVisible;
+    int prevVisible = onScreen ? prev->lineCount - prev->firstVisible : 0;
+
+    if (!onScreen)
+        len += snprintf(out + len, sizeof(out) - len, "\033[H\033[2J");
+
+    for (int row = 0; row < visible; row++) {
+        int line = frame->firstVisible + row;
+        const char *text = frame->text + frame->lineStart[line];
+        size_t textLen = lineLength(frame, line);
+
+        if (cols > 0 && textLen > cols)
+            textLen = cols;
+
+        if (row < prevVisible) {
+            int old = prev->firstVisible + row;
+            size_t oldLen = lineLength(prev, old);
+            if (cols > 0 && oldLen > cols)
+                oldLen = cols;
+            if (oldLen == textLen && memcmp(prev->text + prev->lineStart[old], text, textLen) == 0)
+                continue;
+        }
+
+        len += snprintf(out + len, sizeof(out) - len, "\033[%d;1H", row + 1);
+        memcpy(out + len, text, textLen);
+        len += textLen;
+        len += snprintf(out + len, sizeof(out) - len, "\033[K");
+    }
+
+    // Clear what is left of a taller previous frame, then park the cursor below this one
+    len += snprintf(out + len, sizeof(out) - len, "\033[%d;1H", visible + 1);
+    if (prevVisible > visible)
+        len += snprintf(out + len, sizeof(out) - len, "\033[J");
+
+    writeAll(out, len);
+    onScreen = 1;
+    current ^= 1;
+}
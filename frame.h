@@ -0,0 +1,20 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stddef.h>
+
+#define FRAME_BUFSIZE (256 * 1024)
+#define FRAME_MAX_LINES 4096
+
+// Every printer writes its lines into the current frame with renderf().
+// frameEnd() compares the frame with the one already on screen and emits
+// only cursor moves plus the changed lines, all in a single write(). In
+// sequential mode the frame is written as-is, still in one write().
+
+// Function prototypes
+void frameBegin(int diff);
+void renderf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void frameEnd(void);
+void frameInvalidate(void);
+
+#endif // FRAME_H
@@ -0,0 +1,150 @@
+#define _GNU_SOURCE
+
+#include "latency.h"
+#include "frame.h"
+#include <stdio.h>
+#include <sys/resource.h>
+
+static LatencyHistogram histograms[LAT_PHASES];
+static uint64_t collectorCpuNs[LAT_COLLECTORS];    // latest CPU time reported by each collector
+
+static const char *phaseNames[LAT_PHASES] = {
+    "collect mem", "collect cpu", "collect top", "collect disk", "collect net", "collect psi", "collect cgroup", "ring transfer", "render", "loop overrun"
+};
+
+// Bucket of a value: exact below 16, then 16 linear steps per power of two
+static int bucketOf(uint64_t ns) {
+    if (ns < (1u << LATENCY_SUB_BITS))
+        return (int)ns;
+
+    int msb = 63 - __builtin_clzll(ns);
+    int shift = msb - LATENCY_SUB_BITS;
+    return ((shift + 1) << LATENCY_SUB_BITS) + (int)((ns >> shift) - (1u << LATENCY_SUB_BITS));
+}
+
+// Midpoint of the values that fall into a bucket
+static uint64_t bucketValue(int bucket) {
+    if (bucket < (1 << LATENCY_SUB_BITS))
+        return bucket;
+
+    int shift = (bucket >> LATENCY_SUB_BITS) - 1;
+    uint64_t low = (uint64_t)((bucket & ((1 << LATENCY_SUB_BITS) - 1)) + (1 << LATENCY_SUB_BITS)) << shift;
+    return low + ((1ull << shift) >> 1);
+}
+
+// Adds one measurement to a phase
+void latencyRecord(int phase, uint64_t ns) {
+    LatencyHistogram *histogram = &histograms[phase];
+
+    histogram->buckets[bucketOf(ns)]++;
+    histogram->count++;
+    histogram->sumNs += ns;
+    if (ns > histogram->maxNs)
+        histogram->maxNs = ns;
+}
+
+// Value below which percentile % of the measurements fall
+uint64_t latencyPercentile(const LatencyHistogram *histogram, double percentile) {
+    uint64_t rank = (uint64_t)(histogram->count * percentile / 100.0 + 0.5), seen = 0;
+
+    if (rank == 0)
+        rank = 1;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            uint64_t value = bucketValue(i);
+            return value < histogram->maxNs ? value : histogram->maxNs;
+        }
+    }
+    return histogram->maxNs;
+}
+
+// Fills the timing fields of a sample the collector is about to push (collector side)
+void latencyStamp(SampleHeader *header, uint64_t startNs) {
+    struct rusage usage;
+
+    header->readyNs = monotonicNs();
+    header->collectNs = (uint32_t)(header->readyNs - startNs);
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        header->cpuNs = (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ull +
+                        (uint64_t)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ull;
+}
+
+// Records the collect and transfer time of a sample just popped from a collector's ring
+void latencyReceived(int collector, const SampleHeader *header) {
+    uint64_t now = monotonicNs();
+
+    latencyRecord(LAT_COLLECT_MEM + collector, header->collectNs);
+    latencyRecord(LAT_TRANSFER, now > header->readyNs ? now - header->readyNs : 0);
+    collectorCpuNs[collector] = header->cpuNs;
+}
+
+// Formats a duration with a unit that keeps 3-4 significant digits
+static void formatNs(uint64_t ns, char *out, size_t size) {
+    if (ns < 1000)
+        snprintf(out, size, "%lluns", (unsigned long long)ns);
+    else if (ns < 1000000)
+        snprintf(out, size, "%.1fus", ns / 1e3);
+    else if (ns < 1000000000)
+        snprintf(out, size, "%.2fms", ns / 1e6);
+    else
+        snprintf(out, size, "%.2fs", ns / 1e9);
+}
+
+// Renders the p99 of every phase measured so far, plus the collectors' CPU time, on one line
+void printLatencyLine(void) {
+    static const char *shortNames[LAT_PHASES] = { "mem", "cpu", "top", "disk", "net", "psi", "cgroup", "xfer", "render", "late" };
+    char value[16];
+    uint64_t cpuNs = 0;
+    int shown = 0;
+
+    for (int phase = 0; phase < LAT_PHASES; phase++) {
+        if (histograms[phase].count == 0)
+            continue;
+        formatNs(latencyPercentile(&histograms[phase], 99.0), value, sizeof(value));
+        renderf("%s%s %s", shown++ ? " " : "Self p99: ", shortNames[phase], value);
+    }
+
+    for (int i = 0; i < LAT_COLLECTORS; i++)
+        cpuNs += collectorCpuNs[i];
+    if (cpuNs > 0) {
+        formatNs(cpuNs, value, sizeof(value));
+        renderf("%scollectors CPU %s", shown++ ? " | " : "", value);
+    }
+    if (shown)
+        renderf("\n");
+}
+
+// Prints the full percentile table and the CPU time of the monitor and its children
+void printLatencySummary(void) {
+    struct rusage self, children;
+    char values[5][16];
+
+    printf("### Monitor overhead ###\n");
+    printf("%-14s %8s %9s %9s %9s %9s %9s\n", "phase", "count", "p50", "p90", "p99", "p99.9", "max");
+
+    for (int phase = 0; phase < LAT_PHASES; phase++) {
+        const LatencyHistogram *histogram = &histograms[phase];
+        if (histogram->count == 0)
+            continue;
+
+        formatNs(latencyPercentile(histogram, 50.0), values[0], sizeof(values[0]));
+        formatNs(latencyPercentile(histogram, 90.0), values[1], sizeof(values[1]));
+        formatNs(latencyPercentile(histogram, 99.0), values[2], sizeof(values[2]));
+        formatNs(latencyPercentile(histogram, 99.9), values[3], sizeof(values[3]));
+        formatNs(histogram->maxNs, values[4], sizeof(values[4]));
+        printf("%-14s %8llu %9s %9s %9s %9s %9s\n", phaseNames[phase], (unsigned long long)histogram->count,
+               values[0], values[1], values[2], values[3], values[4]);
+    }
+
+    if (getrusage(RUSAGE_SELF, &self) == 0)
+        printf("Monitor CPU time: user %.2f ms, system %.2f ms\n",
+               self.ru_utime.tv_sec * 1e3 + self.ru_utime.tv_usec / 1e3,
+               self.ru_stime.tv_sec * 1e3 + self.ru_stime.tv_usec / 1e3);
+    if (getrusage(RUSAGE_CHILDREN, &children) == 0 &&
+        (children.ru_utime.tv_sec || children.ru_utime.tv_usec || children.ru_stime.tv_sec || children.ru_stime.tv_usec))
+        printf("Collectors CPU time: user %.2f ms, system %.2f ms\n",
+               children.ru_utime.tv_sec * 1e3 + children.ru_utime.tv_usec / 1e3,
+               children.ru_stime.tv_sec * 1e3 + children.ru_stime.tv_usec / 1e3);
+}
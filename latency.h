@@ -0,0 +1,42 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include "scheduler.h"
+
+// Log-linear (HDR-style) histogram: 16 sub-buckets per power of two,
+// so any recorded value is reported within ~6% from 1 ns up to centuries.
+#define LATENCY_SUB_BITS 4
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+
+typedef struct {
+    uint64_t count, sumNs, maxNs;
+    uint32_t buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+// Phases of one iteration the monitor times on itself
+enum {
+    LAT_COLLECT_MEM,    // collector time per sample, one per collector
+    LAT_COLLECT_CPU,
+    LAT_COLLECT_TOP,
+    LAT_COLLECT_DISK,
+    LAT_COLLECT_NET,
+    LAT_COLLECT_PSI,
+    LAT_COLLECT_CGROUP,
+    LAT_TRANSFER,       // ring push in the child to pop in the parent
+    LAT_RENDER,         // drawing one frame
+    LAT_OVERRUN,        // how late the loop woke after its tick deadline
+    LAT_PHASES
+};
+
+#define LAT_COLLECTORS 7    // the LAT_COLLECT_* phases
+
+// Function prototypes
+void latencyRecord(int phase, uint64_t ns);
+uint64_t latencyPercentile(const LatencyHistogram *histogram, double percentile);
+void latencyStamp(SampleHeader *header, uint64_t startNs);
+void latencyReceived(int collector, const SampleHeader *header);
+void printLatencyLine(void);
+void printLatencySummary(void);
+
+#endif // LATENCY_H
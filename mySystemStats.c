@@ -1,15 +1,100 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include "stats_functions.h"
+#include "recorder.h"
+#include "exporter.h"
+#include "proc_top.h"
+#include "diskstats.h"
+#include "netdev.h"
+#include "psi.h"
+#include "rollup.h"
+#include "fleet.h"
+#include "cgroups.h"
+#include "alerts.h"
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <getopt.h>
 #include <sys/wait.h>
+#include <sys/epoll.h>
 #include <stdio.h>
 
-pid_t memPID, userPID, cpuPID;
+#define ENGINE_FORK 0
+#define ENGINE_LOOP 1
+
+typedef struct {
+    int samples;
+    uint64_t intervalNs;
+    int showUser, showSystem, sequential, graphics;
+    int engine;
+    const char *recordPath;     // --record: write samples to a file instead of rendering
+    int compress;               // --compress: record in compressed chunks
+    const char *replayPath;     // --replay: render a recorded file instead of sampling
+    double speed;               // replay speed-up; 0 replays as fast as possible
+    uint64_t seekNs;            // replay start, relative to the first record
+    const char *exportPath;     // --export: serve Prometheus text on this Unix socket
+    const char *agentAddr;      // --agent: stream samples to an aggregator
+    const char *hostName;       // --host: name sent by --agent (default: hostname)
+    const char *aggregateAddr;  // --aggregate: merge agent streams into a fleet view
+    int top;                    // --top: show the top CPU consumers
+    int disk;                   // --disk: show per-device I/O rates
+    int net;                    // --net: show per-interface throughput
+    int psi;                    // --psi: show pressure stall information
+    int cgroups;                // --cgroups: show the busiest cgroups
+    int rollupWindows;          // --rollup: number of aggregation windows (0 = off)
+    uint64_t rollupNs[ROLLUP_MAX_WINDOWS];
+    const char *alertsPath;     // --alerts: threshold rules evaluated on every sample
+    const char *alertLog;       // --alert-log: append events here instead of stdout
+    const char *alertHook;      // --alert-exec: shell command run on every event
+    int adaptive;               // --adaptive: sample faster while memory or CPU moves
+} Options;
+
+// Parent-side state carried from one rendered iteration to the next
+typedef struct {
+    History history;
+    SessionTable sessions;
+    Recorder recorder;
+    Exporter exporter;
+    FleetAgent agent;
+    int recordedSessions;       // session count of the replayed record, -1 when live
+    MemSample mem;              // latest memory sample
+    int haveMem;
+    CpuSample cpu;              // latest per-core usage
+    int haveCpu;
+    TopSample top;              // latest top-N processes (--top)
+    int haveTop;
+    DiskSample disk;            // latest per-device I/O rates (--disk)
+    int haveDisk;
+    NetSample net;              // latest per-interface rates (--net)
+    NetHistory netHistory;
+    int haveNet;
+    PsiSample psi;              // latest pressure stall information (--psi)
+    int havePsi;
+    CgroupSample cgroups;       // latest per-cgroup usage (--cgroups)
+    int haveCgroups;
+    Rollups rollups;            // windowed min/mean/max/percentiles (--rollup, or from a recording)
+    Alerts alerts;              // compiled --alerts rules and their state
+    AdaptiveRate rate;          // current interval of an --adaptive run
+} RenderState;
+
+#define REPLAY_FRAME_NS 33000000ull   // fastest replay frame rate (~30 fps)
+
+#define MAX_COLLECTORS 8
+
+pid_t collectorPIDs[MAX_COLLECTORS];
+int collectorCount;
+
+// A registered collector sampled in this run and the RenderState fields its samples land in
+typedef struct {
+    const CollectorOps *ops;
+    void *sample;
+    int *have;
+    uint32_t slots;             // ring capacity (fork engine)
+    SampleRing *ring;           // fork engine: filled by the collector child
+    Collector collector;        // loop engine: sampled in-process
+} Source;
 
 void ignoreCtrlZ() {
     struct sigaction action;
@@ -31,20 +116,22 @@ void handleSigInt(int signal) {
 
     if (signal == SIGINT) {
         printf("\nCtrl-C detected. Terminate? (y/yes or n/no): ");
-        scanf(" %9s", input);
+        // No terminal to answer (e.g. a background recorder): treat EOF as yes
+        int answered = scanf(" %9s", input) == 1;
 
-        if (strcasecmp(input, "y") == 0 || strcasecmp(input, "yes") == 0) {
-            kill(memPID, SIGTERM);
-            kill(userPID, SIGTERM);
-            kill(cpuPID, SIGTERM);
-
-            waitpid(memPID, NULL, 0);
-            waitpid(userPID, NULL, 0);
-            waitpid(cpuPID, NULL, 0);
+        if (!answered || strcasecmp(input, "y") == 0 || strcasecmp(input, "yes") == 0) {
+            // The loop engine forks nothing, so the list is empty there
+            for (int i = 0; i < collectorCount; i++)
+                kill(collectorPIDs[i], SIGTERM);
+            for (int i = 0; i < collectorCount; i++)
+                waitpid(collectorPIDs[i], NULL, 0);
 
+            printLatencySummary();
             exit(EXIT_SUCCESS);
         } else {
             printf("Continuing...\n");
+            // The prompt scrolled the screen; the next frame redraws everything
+            frameInvalidate();
         }
     }
 }
@@ -55,149 +142,611 @@ void setupSignals() {
     sigemptyset(&act.sa_mask);
     act.sa_flags = 0;
 
+    // SIGSTOP cannot be caught, so only SIGINT and SIGTSTP are handled
     if (sigaction(SIGINT, &act, NULL) == -1 ||
-        sigaction(SIGTSTP, &act, NULL) == -1 ||
-        sigaction(SIGSTOP, &act, NULL) == -1) {
+        sigaction(SIGTSTP, &act, NULL) == -1) {
         perror("Error setting up signal handlers");
         exit(EXIT_FAILURE);
     }
 }
 
-int main(int argc, char *argv[]) {
-    ignoreCtrlZ();
+void drawIteration(const Options *opts, RenderState *state, int i,
+                   const MemSample *mem, const CpuSample *cpu, SampleRing *userRing);
+
+// Renders one iteration from the samples of the current tick (either may be NULL)
+void renderIteration(const Options *opts, RenderState *state, int i,
+                     const MemSample *mem, const CpuSample *cpu, SampleRing *userRing) {
+    // Drain the session events every tick, shown or not, so the user collector never backs up
+    drainSessions(userRing, &state->sessions);
+    rollupPush(&state->rollups, mem, cpu);
+    if (alertsEvaluate(&state->alerts, mem, cpu) > 0 && state->alerts.logFd == STDOUT_FILENO)
+        frameInvalidate();  // the event lines scrolled the screen
+
+    // Headless modes: record, export and/or stream instead of drawing
+    if (opts->recordPath || opts->exportPath || opts->agentAddr) {
+        if (opts->recordPath &&
+            recorderAppend(&state->recorder, mem, cpu, state->sessions.count, &state->rollups) == -1) {
+            perror("Failed to append to record file");
+            exit(EXIT_FAILURE);
+        }
+        if (opts->exportPath)
+            exporterPublish(&state->exporter, mem, cpu, state->sessions.count);
+        if (opts->agentAddr)
+            fleetAgentPush(&state->agent, mem, cpu, state->sessions.count);
+        return;
+    }
 
-    int samples = 10, tdelay = 1;
-    int showUser = 0, showSystem = 0, sequential = 0, graphics = 0;
+    uint64_t start = monotonicNs();
+    if (opts->net && state->haveNet)
+        netHistoryPush(&state->netHistory, &state->net);
+    historyPush(&state->history, mem, cpu, mem ? mem->virtUsedGb : 0.0);
+    drawIteration(opts, state, i, mem, cpu, userRing);
+    latencyRecord(LAT_RENDER, monotonicNs() - start);
+}
 
-    struct option options[] = {
-        {"system", no_argument, 0, 's'},
-        {"user", no_argument, 0, 'u'},
-        {"graphics", no_argument, 0, 'g'},
-        {"sequential", no_argument, 0, 'a'},
-        {"samples", optional_argument, 0, 'b'},
-        {"tdelay", optional_argument, 0, 'c'},
-        {0, 0, 0, 0}
-    };
+// Prints the sessions block: the live table, or the count stored in a replayed record
+void printSessions(RenderState *state, SampleRing *userRing) {
+    if (state->recordedSessions >= 0)
+        renderf("### Sessions/users ###\n%d session(s) at record time\n", state->recordedSessions);
+    else
+        printUserInfoThird(userRing, &state->sessions);
+}
 
-    int opt;
-    while ((opt = getopt_long(argc, argv, "sugab::c::", options, NULL)) != -1) {
-        switch (opt) {
-            case 's': showSystem = 1; break;
-            case 'u': showUser = 1; break;
-            case 'g': graphics = 1; break;
-            case 'a': sequential = 1; break;
-            case 'b': if (optarg) samples = atoi(optarg); break;
-            case 'c': if (optarg) tdelay = atoi(optarg); break;
-        }
+// Draws one frame from the history; mem and cpu (either may be NULL) supply the memory and per-core breakdowns
+void drawIteration(const Options *opts, RenderState *state, int i,
+                   const MemSample *mem, const CpuSample *cpu, SampleRing *userRing) {
+    frameBegin(!opts->sequential);
+    GetInfoTop(opts->samples, opts->adaptive ? state->rate.intervalNs : opts->intervalNs, opts->sequential, i);
+    printLatencyLine();
+    if (state->alerts.count > 0)
+        printAlerts(&state->alerts);
+
+    if (cpu) {
+        renderf("Total CPU Usage: %.2f%% (over %.2f ms)\n", cpu->busy[0], cpu->intervalNs / 1e6);
+        if (opts->graphics)
+            setCpuGraphics(&state->history);
     }
 
-    for (int i = optind, count = 0; i < argc && count < 2; i++, count++) {
-        if (count == 0) samples = atoi(argv[i]);
-        if (count == 1) tdelay = atoi(argv[i]);
+    if (opts->showSystem || (!opts->showUser && !opts->showSystem)) {
+        fcnForPrintMemoryArr(opts->sequential, &state->history, opts->graphics);
+        if (mem)
+            printMemBreakdown(mem);
+        renderf("---------------------------------------\n");
+
+        if (opts->psi && state->havePsi) {
+            printPsi(&state->psi);
+            renderf("---------------------------------------\n");
+        }
+
+        if (state->rollups.count > 0) {
+            printRollups(&state->rollups);
+            renderf("---------------------------------------\n");
+        }
+
+        if (opts->showUser || (!opts->showUser && !opts->showSystem)) {
+            printSessions(state, userRing);
+            renderf("---------------------------------------\n");
+        }
+
+        printCores(cpu);
+
+        if (opts->top && state->haveTop) {
+            renderf("---------------------------------------\n");
+            printTopProcs(&state->top);
+        }
+
+        if (opts->disk && state->haveDisk) {
+            renderf("---------------------------------------\n");
+            printDisks(&state->disk);
+        }
+
+        if (opts->net && state->haveNet) {
+            renderf("---------------------------------------\n");
+            printNet(&state->net, &state->netHistory);
+        }
+
+        if (opts->cgroups && state->haveCgroups) {
+            renderf("---------------------------------------\n");
+            printCgroups(&state->cgroups);
+        }
+    } else {
+        printSessions(state, userRing);
     }
 
-    int memFD[2], userFD[2], cpuPFD[2], cpuCFD[2], ucountFD[2];
-    if (pipe(memFD) == -1 || pipe(userFD) == -1 || pipe(cpuPFD) == -1 ||
-        pipe(cpuCFD) == -1 || pipe(ucountFD) == -1) {
-        perror("Pipe creation failed");
+    frameEnd();
+}
+
+// Appends the collector called name to the sources of this run
+static void addSource(Source *sources, int *count, const char *name, void *sample, int *have, uint32_t slots) {
+    Source *source = &sources[(*count)++];
+
+    memset(source, 0, sizeof(Source));
+    source->ops = collectorFind(name);
+    source->sample = sample;
+    source->have = have;
+    source->slots = slots;
+}
+
+// Lists the collectors this run samples: memory and CPU always, the others when their view is on
+int listSources(const Options *opts, RenderState *state, Source *sources) {
+    int count = 0;
+
+    addSource(sources, &count, "mem", &state->mem, &state->haveMem, 16);
+    addSource(sources, &count, "cpu", &state->cpu, &state->haveCpu, 16);
+    if (opts->top)
+        addSource(sources, &count, "top", &state->top, &state->haveTop, 4);
+    if (opts->disk)
+        addSource(sources, &count, "disk", &state->disk, &state->haveDisk, 4);
+    if (opts->net)
+        addSource(sources, &count, "net", &state->net, &state->haveNet, 4);
+    if (opts->psi)
+        addSource(sources, &count, "psi", &state->psi, &state->havePsi, 4);
+    if (opts->cgroups)
+        addSource(sources, &count, "cgroups", &state->cgroups, &state->haveCgroups, 4);
+    return count;
+}
+
+// Forks a collector child until the clock stops: body when given, else the registered collector name
+void spawnCollector(const char *name, void (*body)(SampleClock *, SampleRing *), SampleClock *clock,
+                    SampleRing *ring) {
+    pid_t pid = fork();
+
+    if (pid == -1) {
+        perror("Failed to fork collector");
         exit(EXIT_FAILURE);
     }
-
-    if ((memPID = fork()) == 0) {
+    if (pid == 0) {
         childIgnoreSigInt();
-        close(memFD[0]);
-        close(userFD[0]); close(userFD[1]);
-        close(cpuPFD[0]); close(cpuPFD[1]);
-        close(cpuCFD[0]); close(cpuCFD[1]);
-        close(ucountFD[0]); close(ucountFD[1]);
-
-        storeMemArr(samples, memFD, tdelay);
-        close(memFD[1]);
+        if (body)
+            body(clock, ring);
+        else
+            collectorRun(name, clock, ring);
         exit(0);
     }
+    collectorPIDs[collectorCount++] = pid;
+}
 
-    if ((userPID = fork()) == 0) {
-        childIgnoreSigInt();
-        close(userFD[0]);
-        close(memFD[0]); close(memFD[1]);
-        close(cpuPFD[0]); close(cpuPFD[1]);
-        close(cpuCFD[0]); close(cpuCFD[1]);
-        close(ucountFD[0]);
-
-        storeUserInfoThird(userFD, ucountFD);
-        close(userFD[1]);
-        close(ucountFD[1]);
-        exit(0);
+// Starts the --export socket and its serving thread. The fork engine calls it only once
+// the collectors are forked, so they inherit neither the thread nor the listening socket
+static void openExporter(const Options *opts, RenderState *state) {
+    if (opts->exportPath && exporterOpen(&state->exporter, opts->exportPath) == -1) {
+        perror("Failed to open export socket");
+        exit(EXIT_FAILURE);
     }
+}
 
-    if ((cpuPID = fork()) == 0) {
-        childIgnoreSigInt();
-        close(cpuPFD[0]);
-        close(cpuCFD[0]);
-        close(memFD[0]); close(memFD[1]);
-        close(userFD[0]); close(userFD[1]);
-        close(ucountFD[0]); close(ucountFD[1]);
-
-        for (int i = 0; i < samples; i++) {
-            storeCpuArr(cpuPFD);
-            sleep(tdelay);
-            storeCpuArr(cpuCFD);
-        }
-        close(cpuPFD[1]);
-        close(cpuCFD[1]);
-        exit(0);
+// Forks one collector process per metric; they feed the parent through shared rings
+void runForkEngine(const Options *opts, RenderState *state) {
+    Source sources[MAX_COLLECTORS];
+    int sourceCount = listSources(opts, state, sources);
+    SampleRing *userRing = ringCreate(MAX_SESSIONS, sizeof(SessionSample));
+    SampleClock *clock = clockCreate(opts->intervalNs);
+    int failed = !userRing || !clock;
+
+    for (int s = 0; s < sourceCount; s++) {
+        sources[s].ring = ringCreate(sources[s].slots, sources[s].ops->sampleSize);
+        failed |= !sources[s].ring;
+    }
+    if (failed) {
+        perror("Shared ring creation failed");
+        exit(EXIT_FAILURE);
     }
 
+    spawnCollector("users", storeUserInfoThird, clock, userRing);
+    for (int s = 0; s < sourceCount; s++)
+        spawnCollector(sources[s].ops->name, NULL, clock, sources[s].ring);
+
     // Parent process
-    close(memFD[1]); close(userFD[1]); close(cpuPFD[1]); close(cpuCFD[1]); close(ucountFD[1]);
+    openExporter(opts, state);
+    setupSignals();
+    clockStart(clock);
+
+    for (int i = 0; opts->samples == 0 || i < opts->samples; i++) {
+        uint32_t tick = i + 1;
+        uint64_t deadline = clockDeadline(clock, tick);
+        clockSleepUntil(deadline);
+        latencyRecord(LAT_OVERRUN, monotonicNs() - deadline);
+        clockPublish(clock, tick);
+
+        for (int s = 0; s < sourceCount; s++) {
+            Source *source = &sources[s];
+            *source->have = popSample(source->ring, source->sample, tick) == 0;
+            if (*source->have)
+                latencyReceived(source->ops->latencyPhase, source->sample);
+        }
+        const MemSample *mem = state->haveMem ? &state->mem : NULL;
+        const CpuSample *cpu = state->haveCpu ? &state->cpu : NULL;
+        renderIteration(opts, state, i, mem, cpu, userRing);
+        if (opts->adaptive)
+            clockSetInterval(clock, tick, adaptiveUpdate(&state->rate, mem, cpu));
+    }
+
+    clockStop(clock);
+    for (int i = 0; i < collectorCount; i++)
+        waitpid(collectorPIDs[i], NULL, 0);
+    collectorCount = 0;
+    for (int s = 0; s < sourceCount; s++)
+        ringDestroy(sources[s].ring);
+    ringDestroy(userRing);
+    clockDestroy(clock);
+}
+
+// Runs every collector in this process, driven by one timerfd on an epoll loop
+void runLoopEngine(const Options *opts, RenderState *state) {
+    static Source sources[MAX_COLLECTORS];
+    int sourceCount = listSources(opts, state, sources);
+
+    SampleClock *clock = clockCreate(opts->intervalNs);
+    if (!clock) {
+        perror("Clock creation failed");
+        exit(EXIT_FAILURE);
+    }
 
+    openExporter(opts, state);
     setupSignals();
+    if (sampleUsers(&state->sessions) == -1)
+        exit(EXIT_FAILURE);
 
-    int userLineCount = 0;
-    read(ucountFD[0], &userLineCount, sizeof(userLineCount));
+    // The first sample is the baseline of the snapshot collectors; it is never drawn
+    clockStart(clock);
+    for (int s = 0; s < sourceCount; s++) {
+        if (collectorOpen(&sources[s].collector, sources[s].ops->name) == -1) {
+            perror(sources[s].ops->name);
+            exit(EXIT_FAILURE);
+        }
+        collectorSample(&sources[s].collector, sources[s].sample);
+    }
 
-    char memArr[samples][1024];
-    char cpuArr[samples][200];
-    double prevVirt = 0.0, currVirt = 0.0;
-    float cpuUsage = 0.0f, prevCpuUsage = 0.0f;
+    int timerFD = clockTimerFd(clock);
+    int epollFD = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = { .events = EPOLLIN, .data.fd = timerFD };
+    if (timerFD == -1 || epollFD == -1 || epoll_ctl(epollFD, EPOLL_CTL_ADD, timerFD, &event) == -1) {
+        perror("Event loop setup failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // utmp changes re-read the session table; without inotify it stays as read at start
+    int watchFD = sessionWatchOpen();
+    event.data.fd = watchFD;
+    if (watchFD != -1 && epoll_ctl(epollFD, EPOLL_CTL_ADD, watchFD, &event) == -1) {
+        close(watchFD);
+        watchFD = -1;
+    }
 
-    for (int i = 0; i < samples; i++) {
-        sleep(tdelay);
-        GetInfoTop(samples, tdelay, sequential, i);
+    uint32_t tick = 0;
+    int failed = 0;
+    for (int i = 0; !failed && (opts->samples == 0 || i < opts->samples); ) {
+        struct epoll_event ready;
+        if (epoll_wait(epollFD, &ready, 1, -1) <= 0)
+            continue;   // interrupted by Ctrl-C
+
+        if (ready.data.fd == watchFD) {
+            if (sessionWatchChanged(watchFD))
+                failed = sampleUsers(&state->sessions) == -1;   // stops the loop
+            continue;
+        }
 
-        if (read(memFD[0], memArr[i], sizeof(memArr[i])) > 0) {
-            if (graphics) {
-                currVirt = calculateVirtUsed();
-                memoryGraphics(currVirt, &prevVirt, memArr, i);
+        uint64_t expirations;
+        if (ready.data.fd != timerFD || read(timerFD, &expirations, sizeof(expirations)) != sizeof(expirations))
+            continue;
+        tick += expirations;
+        latencyRecord(LAT_OVERRUN, monotonicNs() - clockDeadline(clock, tick));
+
+        for (int s = 0; s < sourceCount; s++) {
+            Source *source = &sources[s];
+            uint64_t start = monotonicNs();
+            *source->have = collectorSample(&source->collector, source->sample) == 0;
+            ((SampleHeader *)source->sample)->tick = tick;
+            latencyRecord(source->ops->latencyPhase, monotonicNs() - start);
+        }
+
+        const MemSample *mem = state->haveMem ? &state->mem : NULL;
+        const CpuSample *cpu = state->haveCpu ? &state->cpu : NULL;
+        renderIteration(opts, state, i, mem, cpu, NULL);
+        i++;
+
+        // A new interval re-anchors the schedule at this tick; the timer follows it
+        uint64_t intervalNs = opts->adaptive ? adaptiveUpdate(&state->rate, mem, cpu) : clock->intervalNs;
+        if (intervalNs != clock->intervalNs) {
+            clockSetInterval(clock, tick, intervalNs);
+            if (clockRearmTimerFd(clock, timerFD, tick) == -1) {
+                perror("Failed to re-arm the sample timer");
+                exit(EXIT_FAILURE);
             }
         }
+    }
+
+    for (int s = 0; s < sourceCount; s++)
+        collectorClose(&sources[s].collector);
+    if (watchFD != -1)
+        close(watchFD);
+    close(epollFD);
+    close(timerFD);
+    clockDestroy(clock);
+}
+
+// Collects nothing locally: merges the streams of --agent processes and draws the fleet view each tick
+void runAggregator(const Options *opts) {
+    static FleetAggregator fleet;
+
+    SampleClock *clock = clockCreate(opts->intervalNs);
+    if (!clock) {
+        perror("Clock creation failed");
+        exit(EXIT_FAILURE);
+    }
+    setupSignals();
+    clockStart(clock);
+
+    int timerFD = clockTimerFd(clock);
+    if (timerFD == -1 || fleetAggregatorOpen(&fleet, opts->aggregateAddr, timerFD) == -1) {
+        perror("Failed to open aggregator socket");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; opts->samples == 0 || i < opts->samples; ) {
+        if (fleetAggregatorServe(&fleet) == 0)
+            continue;   // interrupted by Ctrl-C
+
+        uint64_t start = monotonicNs();
+        frameBegin(!opts->sequential);
+        GetInfoTop(opts->samples, opts->intervalNs, opts->sequential, i);
+        printFleet(&fleet);
+        frameEnd();
+        latencyRecord(LAT_RENDER, monotonicNs() - start);
+        i++;
+    }
+
+    fleetAggregatorClose(&fleet);
+    close(timerFD);
+    clockDestroy(clock);
+}
+
+// Feeds a recorded file through the normal render path, paced by --speed.
+// Records that arrive faster than REPLAY_FRAME_NS still enter the history but skip drawing.
+void runReplay(const Options *opts, RenderState *state) {
+    RecordReader reader;
+    static MemSample mem;
+    static CpuSample cpu;
 
-        if (read(cpuPFD[0], &prevCpuUsage, sizeof(prevCpuUsage)) > 0 &&
-            read(cpuCFD[0], &cpuUsage, sizeof(cpuUsage)) > 0) {
-            float usage = calculateCpuUsage(&prevCpuUsage, &cpuUsage);
-            printf("Total CPU Usage: %.2f%%\n", usage);
-            if (graphics)
-                setCpuGraphics(sequential, cpuArr, usage, &prevCpuUsage, i);
+    if (readerOpen(&reader, opts->replayPath) == -1) {
+        perror("Failed to open replay file");
+        exit(EXIT_FAILURE);
+    }
+    setupSignals();
+
+    if (reader.count == 0) {
+        printf("No samples in %s\n", opts->replayPath);
+        readerClose(&reader);
+        return;
+    }
+
+    uint64_t start = readerSeek(&reader, readerAt(&reader, 0)->timestampNs + opts->seekNs);
+    Options shown = *opts;
+    shown.samples = reader.count - start;
+    shown.intervalNs = reader.header->intervalNs;
+    shown.adaptive = readerFastIntervalNs(&reader) != 0;
+    state->rate.intervalNs = reader.header->intervalNs;
+
+    // Recorded aggregates win; otherwise --rollup computes them from the replayed samples
+    int recordedRollups = reader.header->rollupWindows > 0;
+    if (!recordedRollups && opts->rollupWindows > 0 &&
+        rollupInit(&state->rollups, opts->rollupNs, opts->rollupWindows,
+                   shown.adaptive ? readerFastIntervalNs(&reader) : reader.header->intervalNs) == -1) {
+        perror("Failed to allocate rollup windows");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t base = start < reader.count ? readerAt(&reader, start)->timestampNs : 0;
+    uint64_t wallStart = monotonicNs(), lastFrame = 0, prevNs = 0;
+
+    for (uint64_t n = start; n < reader.count; n++) {
+        const RecordSample *record = readerAt(&reader, n);
+        readerSamples(&reader, record, &mem, &cpu);
+        state->recordedSessions = record->sessions;
+        if (n > start) {
+            // Records carry their own timestamps, so variable (adaptive) spacing replays as recorded
+            cpu.intervalNs = record->timestampNs - prevNs;
+            state->rate.intervalNs = cpu.intervalNs;
+        }
+        prevNs = record->timestampNs;
+
+        if (opts->speed > 0)
+            clockSleepUntil(wallStart + (uint64_t)((record->timestampNs - base) / opts->speed));
+
+        historyPush(&state->history, &mem, &cpu, mem.virtUsedGb);
+        if (recordedRollups)
+            readerRollups(&reader, record, &state->rollups);
+        else
+            rollupPush(&state->rollups, &mem, &cpu);
+        if (alertsEvaluate(&state->alerts, &mem, &cpu) > 0 && state->alerts.logFd == STDOUT_FILENO)
+            frameInvalidate();
+
+        uint64_t now = monotonicNs();
+        if (n + 1 == reader.count || now - lastFrame >= REPLAY_FRAME_NS) {
+            drawIteration(&shown, state, n - start, &mem, &cpu, NULL);
+            lastFrame = now;
         }
 
-        if (showSystem || (!showUser && !showSystem)) {
-            fcnForPrintMemoryArr(sequential, samples, memArr, i, memFD);
-            printf("---------------------------------------\n");
+        if (n % 4096 == 4095)
+            readerRelease(&reader, n);
+    }
 
-            if (showUser || (!showUser && !showSystem)) {
-                printUserInfoThird(userFD);
-                printf("---------------------------------------\n");
-            }
+    readerClose(&reader);
+}
 
-            printCores();
-        } else {
-            printUserInfoThird(userFD);
+int main(int argc, char *argv[]) {
+    ignoreCtrlZ();
+
+    Options opts = { .samples = 10, .intervalNs = 1000000000ull, .engine = ENGINE_FORK, .speed = 1.0 };
+
+    struct option options[] = {
+        {"system", no_argument, 0, 's'},
+        {"user", no_argument, 0, 'u'},
+        {"graphics", no_argument, 0, 'g'},
+        {"sequential", no_argument, 0, 'a'},
+        {"samples", optional_argument, 0, 'b'},
+        {"tdelay", optional_argument, 0, 'c'},
+        {"engine", required_argument, 0, 'e'},
+        {"record", required_argument, 0, 'r'},
+        {"replay", required_argument, 0, 'p'},
+        {"speed", required_argument, 0, 'x'},
+        {"seek", required_argument, 0, 'k'},
+        {"export", required_argument, 0, 'o'},
+        {"top", no_argument, 0, 't'},
+        {"disk", no_argument, 0, 'd'},
+        {"net", no_argument, 0, 'n'},
+        {"psi", no_argument, 0, 'P'},
+        {"cgroups", no_argument, 0, 'C'},
+        {"rollup", optional_argument, 0, 'R'},
+        {"compress", no_argument, 0, 'z'},
+        {"agent", required_argument, 0, 'A'},
+        {"host", required_argument, 0, 'H'},
+        {"aggregate", required_argument, 0, 'G'},
+        {"alerts", required_argument, 0, 'L'},
+        {"alert-log", required_argument, 0, 'O'},
+        {"alert-exec", required_argument, 0, 'X'},
+        {"adaptive", optional_argument, 0, 'F'},
+        {0, 0, 0, 0}
+    };
+
+    AdaptiveRate adaptive;
+    parseAdaptive(NULL, &adaptive);
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "sugab::c::", options, NULL)) != -1) {
+        switch (opt) {
+            case 's': opts.showSystem = 1; break;
+            case 'u': opts.showUser = 1; break;
+            case 'g': opts.graphics = 1; break;
+            case 'a': opts.sequential = 1; break;
+            case 'b': if (optarg) opts.samples = atoi(optarg); break;
+            case 'c':
+                if (optarg && parseInterval(optarg, &opts.intervalNs) == -1) {
+                    fprintf(stderr, "Invalid --tdelay '%s' (use e.g. 2, 0.5 or 250ms)\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'e':
+                if (strcmp(optarg, "fork") == 0)
+                    opts.engine = ENGINE_FORK;
+                else if (strcmp(optarg, "loop") == 0)
+                    opts.engine = ENGINE_LOOP;
+                else {
+                    fprintf(stderr, "Invalid --engine '%s' (use fork or loop)\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'r': opts.recordPath = optarg; break;
+            case 'p': opts.replayPath = optarg; break;
+            case 'x':
+                opts.speed = atof(optarg);
+                if (opts.speed < 0) {
+                    fprintf(stderr, "Invalid --speed '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'o': opts.exportPath = optarg; break;
+            case 't': opts.top = 1; break;
+            case 'd': opts.disk = 1; break;
+            case 'n': opts.net = 1; break;
+            case 'P': opts.psi = 1; break;
+            case 'C': opts.cgroups = 1; break;
+            case 'z': opts.compress = 1; break;
+            case 'A': opts.agentAddr = optarg; break;
+            case 'H': opts.hostName = optarg; break;
+            case 'G': opts.aggregateAddr = optarg; break;
+            case 'L': opts.alertsPath = optarg; break;
+            case 'O': opts.alertLog = optarg; break;
+            case 'X': opts.alertHook = optarg; break;
+            case 'F':
+                opts.adaptive = 1;
+                if (parseAdaptive(optarg, &adaptive) == -1) {
+                    fprintf(stderr, "Invalid --adaptive '%s' (use FAST[,CPU[,MEM]], e.g. 50ms,5,0.01)\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'R':
+                opts.rollupWindows = parseWindows(optarg ? optarg : ROLLUP_DEFAULT_WINDOWS, opts.rollupNs);
+                if (opts.rollupWindows == -1) {
+                    fprintf(stderr, "Invalid --rollup '%s' (use up to %d windows, e.g. 10s,1m,5m)\n",
+                            optarg, ROLLUP_MAX_WINDOWS);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'k': opts.seekNs = (uint64_t)(atof(optarg) * 1e9); break;
+        }
+    }
+
+    for (int i = optind, count = 0; i < argc && count < 2; i++, count++) {
+        if (count == 0) opts.samples = atoi(argv[i]);
+        if (count == 1 && parseInterval(argv[i], &opts.intervalNs) == -1) {
+            fprintf(stderr, "Invalid tdelay '%s' (use e.g. 2, 0.5 or 250ms)\n", argv[i]);
+            exit(EXIT_FAILURE);
         }
     }
 
-    close(memFD[0]); close(userFD[0]);
-    close(cpuPFD[0]); close(cpuCFD[0]); close(ucountFD[0]);
+    static RenderState state;
+    historyInit(&state.history, opts.replayPath ? 0 : opts.samples);
+    state.recordedSessions = -1;
+    state.rate = adaptive;
+    adaptiveInit(&state.rate, opts.intervalNs);
 
+    if (opts.rollupWindows > 0 && !opts.replayPath &&
+        rollupInit(&state.rollups, opts.rollupNs, opts.rollupWindows,
+                   opts.adaptive ? state.rate.fastNs : opts.intervalNs) == -1) {
+        perror("Failed to allocate rollup windows");
+        exit(EXIT_FAILURE);
+    }
+
+    if (opts.alertsPath && alertsLoad(&state.alerts, opts.alertsPath) == -1)
+        exit(EXIT_FAILURE);
+    if (opts.alertsPath && alertsOpenLog(&state.alerts, opts.alertLog, opts.alertHook) == -1) {
+        perror("Failed to open alert log");
+        exit(EXIT_FAILURE);
+    }
+
+    if (opts.recordPath &&
+        recorderOpen(&state.recorder, opts.recordPath, opts.intervalNs, opts.adaptive ? state.rate.fastNs : 0,
+                     opts.samples, &state.rollups, opts.compress) == -1) {
+        perror("Failed to create record file");
+        exit(EXIT_FAILURE);
+    }
+
+    if (opts.agentAddr && !opts.replayPath && !opts.aggregateAddr &&
+        fleetAgentOpen(&state.agent, opts.agentAddr, opts.hostName, opts.intervalNs) == -1) {
+        perror("Invalid --agent address");
+        exit(EXIT_FAILURE);
+    }
+
+    if (opts.aggregateAddr)
+        runAggregator(&opts);
+    else if (opts.replayPath)
+        runReplay(&opts, &state);
+    else if (opts.engine == ENGINE_LOOP)
+        runLoopEngine(&opts, &state);
+    else
+        runForkEngine(&opts, &state);
+
+    if (opts.recordPath) {
+        uint64_t count = state.recorder.header->count;
+        printf("Recorded %llu samples to %s (%.1f bytes/sample)\n", (unsigned long long)count, opts.recordPath,
+               count ? (double)recorderDataBytes(&state.recorder) / count : 0.0);
+        recorderClose(&state.recorder);
+    }
+    if (opts.exportPath && !opts.replayPath && !opts.aggregateAddr)
+        exporterClose(&state.exporter);
+    if (opts.agentAddr && !opts.replayPath && !opts.aggregateAddr) {
+        fleetAgentClose(&state.agent);
+        printf("Streamed %llu samples to %s (%llu dropped)\n", (unsigned long long)state.agent.sent,
+               opts.agentAddr, (unsigned long long)state.agent.dropped);
+    }
+    if (opts.adaptive && !opts.replayPath && !opts.aggregateAddr)
+        printf("Adaptive sampling: %llu switch(es) to the fast interval\n", (unsigned long long)state.rate.bursts);
+    rollupFree(&state.rollups);
+    alertsClose(&state.alerts);
+
+    printf("------------------------------------\n");
+    printLatencySummary();
     printf("------------------------------------\n");
     printSystemInfoLast();
     printf("------------------------------------\n");
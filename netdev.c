@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+
+#include "netdev.h"
+
+// Opens /proc/net/dev for the lifetime of the collector
+int netInit(NetCollector *net) {
+    return procOpen(&net->netdev, "/proc/net/dev", net->buf, sizeof(net->buf));
+}
+
+void netFree(NetCollector *net) {
+    procClose(&net->netdev);
+}
+
+// Reads every interface row of /proc/net/dev into a snapshot
+void storeNetArr(NetCollector *net, NetSnapshot *snapshot) {
+    int rows = 0;
+
+    if (procRead(&net->netdev) == -1) {
+        perror("Failed to read /proc/net/dev");
+        exit(EXIT_FAILURE);
+    }
+
+    // Two header lines, then "name: rx bytes packets errs drop fifo frame compressed multicast tx bytes packets errs drop ..."
+    const char *p = procSkipLine(procSkipLine(net->netdev.buf));
+    while (*p && rows < MAX_IFACES) {
+        uint64_t f[12] = {0};
+        const char *name = procSkipSpaces(p), *colon = name;
+
+        while (*colon && *colon != ':' && *colon != '\n')
+            colon++;
+        if (*colon != ':') {
+            p = procSkipLine(p);
+            continue;
+        }
+
+        size_t len = colon - name;
+        if (len >= IFACE_NAME_LEN)
+            len = IFACE_NAME_LEN - 1;
+        memcpy(snapshot->name[rows], name, len);
+        snapshot->name[rows][len] = '\0';
+
+        const char *next = colon + 1;
+        for (int k = 0; k < 12 && next; k++)
+            next = procScanU64(next, &f[k]);
+
+        snapshot->rxBytes[rows] = f[0];
+        snapshot->rxPackets[rows] = f[1];
+        snapshot->rxErrs[rows] = f[2];
+        snapshot->rxDrop[rows] = f[3];
+        snapshot->txBytes[rows] = f[8];
+        snapshot->txPackets[rows] = f[9];
+        snapshot->txErrs[rows] = f[10];
+        snapshot->txDrop[rows] = f[11];
+        rows++;
+
+        p = procSkipLine(p);
+    }
+
+    snapshot->count = rows;
+    snapshot->timestampNs = monotonicNs();
+}
+
+// Row of name in a name table: the same row unless interfaces came or went; -1 if absent
+static int matchIface(const char *names, int count, const char *name, int row) {
+    if (row < count && strcmp(names + row * IFACE_NAME_LEN, name) == 0)
+        return row;
+    for (int i = 0; i < count; i++)
+        if (strcmp(names + i * IFACE_NAME_LEN, name) == 0)
+            return i;
+    return -1;
+}
+
+// Growth of a counter; a counter that went backwards (interface recreated) counts as 0
+static double counterDelta(uint64_t curr, uint64_t prev) {
+    return curr < prev ? 0.0 : (double)(curr - prev);
+}
+
+// Computes per-interface byte, packet, drop and error rates between two snapshots
+void calculateNetRates(const NetSnapshot *prev, const NetSnapshot *curr, NetSample *sample) {
+    double seconds = (curr->timestampNs - prev->timestampNs) / 1e9;
+    int count = 0;
+
+    sample->intervalNs = curr->timestampNs - prev->timestampNs;
+    sample->total = curr->count;
+
+    for (int i = 0; i < curr->count; i++) {
+        if (curr->rxPackets[i] == 0 && curr->txPackets[i] == 0)
+            continue;
+
+        int j = matchIface(prev->name[0], prev->count, curr->name[i], i);
+        memcpy(sample->name[count], curr->name[i], IFACE_NAME_LEN);
+
+        if (j == -1 || seconds <= 0) {
+            sample->rxKBps[count] = sample->txKBps[count] = 0.0f;
+            sample->rxPps[count] = sample->txPps[count] = 0.0f;
+            sample->dropPs[count] = sample->errPs[count] = 0.0f;
+        } else {
+            sample->rxKBps[count] = counterDelta(curr->rxBytes[i], prev->rxBytes[j]) / 1024.0 / seconds;
+            sample->txKBps[count] = counterDelta(curr->txBytes[i], prev->txBytes[j]) / 1024.0 / seconds;
+            sample->rxPps[count] = counterDelta(curr->rxPackets[i], prev->rxPackets[j]) / seconds;
+            sample->txPps[count] = counterDelta(curr->txPackets[i], prev->txPackets[j]) / seconds;
+            sample->dropPs[count] = (counterDelta(curr->rxDrop[i], prev->rxDrop[j]) +
+                                     counterDelta(curr->txDrop[i], prev->txDrop[j])) / seconds;
+            sample->errPs[count] = (counterDelta(curr->rxErrs[i], prev->rxErrs[j]) +
+                                    counterDelta(curr->txErrs[i], prev->txErrs[j])) / seconds;
+        }
+        count++;
+    }
+
+    sample->count = count;
+}
+
+// Takes a baseline on tick 0, then pushes the rates of every interval
+void storeNetSamples(SampleClock *clock, SampleRing *netRing) {
+    collectorRun("net", clock, netRing);
+}
+
+static int netCollectorInit(void *state) {
+    return netInit(state);
+}
+
+static int netCollectorSample(void *state, void *out) {
+    storeNetArr(state, out);
+    return 0;
+}
+
+static void netCollectorDiff(void *state, const void *prev, const void *curr, void *out) {
+    NetSample *sample = out;
+
+    (void)state;
+    calculateNetRates(prev, curr, sample);
+    sample->header.timestampNs = ((const NetSnapshot *)curr)->timestampNs;
+}
+
+static void netCollectorTeardown(void *state) {
+    netFree(state);
+}
+
+const CollectorOps netCollector = {
+    .name = "net", .stateSize = sizeof(NetCollector), .snapshotSize = sizeof(NetSnapshot),
+    .sampleSize = sizeof(NetSample), .latencyPhase = LAT_COLLECT_NET, .init = netCollectorInit,
+    .sample = netCollectorSample, .diff = netCollectorDiff, .teardown = netCollectorTeardown,
+};
+
+// Appends the throughput of one interval. Interfaces missing from sample are
+// evicted (so the table never fills up) and the rest keep their order, which
+// lets the row hint of matchIface find them without a scan while the set of
+// interfaces is stable.
+void netHistoryPush(NetHistory *history, const NetSample *sample) {
+    int column = history->samples % NET_SPARK_LEN;
+    int slots[MAX_IFACES], moved[MAX_IFACES], kept = 0;
+    unsigned char seen[MAX_IFACES] = {0};
+
+    for (int i = 0; i < sample->count; i++) {
+        slots[i] = matchIface(history->name[0], history->count, sample->name[i], i);
+        if (slots[i] != -1)
+            seen[slots[i]] = 1;
+    }
+
+    for (int s = 0; s < history->count; s++) {
+        if (!seen[s])
+            continue;
+        if (kept != s) {
+            memcpy(history->name[kept], history->name[s], IFACE_NAME_LEN);
+            memcpy(history->rx[kept], history->rx[s], sizeof(history->rx[s]));
+            memcpy(history->tx[kept], history->tx[s], sizeof(history->tx[s]));
+        }
+        moved[s] = kept++;
+    }
+    history->count = kept;
+
+    for (int i = 0; i < sample->count; i++) {
+        int slot = slots[i] == -1 ? -1 : moved[slots[i]];
+
+        if (slot == -1) {
+            slot = history->count++;
+            memcpy(history->name[slot], sample->name[i], IFACE_NAME_LEN);
+            memset(history->rx[slot], 0, sizeof(history->rx[slot]));
+            memset(history->tx[slot], 0, sizeof(history->tx[slot]));
+        }
+        history->rx[slot][column] = sample->rxKBps[i];
+        history->tx[slot][column] = sample->txKBps[i];
+    }
+
+    history->samples++;
+}
+
+// Draws the window of one series as ASCII levels scaled to its own peak, oldest first
+static void sparkline(const float *series, unsigned long samples, char *out) {
+    static const char levels[] = " .:-=+*#%@";
+    int shown = samples < NET_SPARK_LEN ? (int)samples : NET_SPARK_LEN;
+    float peak = 0.0f;
+
+    for (int k = 0; k < shown; k++)
+        if (series[k] > peak)
+            peak = series[k];
+
+    for (int k = 0; k < NET_SPARK_LEN; k++) {
+        int age = NET_SPARK_LEN - 1 - k;    // 0 = newest
+        if (age >= shown || peak <= 0.0f) {
+            out[k] = ' ';
+            continue;
+        }
+        float value = series[(samples - 1 - age) % NET_SPARK_LEN];
+        int level = (int)(value / peak * (sizeof(levels) - 2) + 0.5f);
+        out[k] = levels[level];
+    }
+    out[NET_SPARK_LEN] = '\0';
+}
+
+// Prints the per-interface rates of the last interval with rx/tx sparklines
+void printNet(const NetSample *sample, const NetHistory *history) {
+    char rx[NET_SPARK_LEN + 1], tx[NET_SPARK_LEN + 1];
+
+    renderf("### Network ### (%d interfaces, %d with traffic)\n", sample->total, sample->count);
+    renderf(" iface        rx KB/s   tx KB/s  rx pkt/s  tx pkt/s  drop/s   err/s\n");
+
+    for (int i = 0; i < sample->count && i < NET_SHOWN; i++) {
+        renderf(" %-10s %9.1f %9.1f %9.1f %9.1f %7.1f %7.1f\n", sample->name[i],
+                sample->rxKBps[i], sample->txKBps[i], sample->rxPps[i], sample->txPps[i],
+                sample->dropPs[i], sample->errPs[i]);
+
+        int slot = matchIface(history->name[0], history->count, sample->name[i], i);
+        if (slot == -1)
+            continue;
+        sparkline(history->rx[slot], history->samples, rx);
+        sparkline(history->tx[slot], history->samples, tx);
+        renderf("   rx |%s|  tx |%s|\n", rx, tx);
+    }
+
+    if (sample->count > NET_SHOWN)
+        renderf(" ... %d more\n", sample->count - NET_SHOWN);
+}
@@ -0,0 +1,56 @@
+#ifndef NETDEV_H
+#define NETDEV_H
+
+#include "stats_functions.h"
+
+#define MAX_IFACES 512
+#define IFACE_NAME_LEN 16
+#define NET_SHOWN 8                 // interfaces drawn per frame
+#define NET_SPARK_LEN 30            // samples per sparkline
+#define NETDEV_BUFSIZE (128 * 1024)
+
+// Raw /proc/net/dev counters, one row per interface in file order
+typedef struct {
+    uint64_t timestampNs;
+    int count;
+    char name[MAX_IFACES][IFACE_NAME_LEN];
+    uint64_t rxBytes[MAX_IFACES], rxPackets[MAX_IFACES], rxErrs[MAX_IFACES], rxDrop[MAX_IFACES];
+    uint64_t txBytes[MAX_IFACES], txPackets[MAX_IFACES], txErrs[MAX_IFACES], txDrop[MAX_IFACES];
+} NetSnapshot;
+
+// State of the net collector: /proc/net/dev kept open between snapshots
+typedef struct {
+    ProcFile netdev;
+    char buf[NETDEV_BUFSIZE];
+} NetCollector;
+
+// Per-interface rates over one interval; interfaces that never saw a packet are left out
+typedef struct {
+    SampleHeader header;
+    uint64_t intervalNs;
+    int count;
+    int total;                      // interfaces listed in /proc/net/dev
+    char name[MAX_IFACES][IFACE_NAME_LEN];
+    float rxKBps[MAX_IFACES], txKBps[MAX_IFACES];
+    float rxPps[MAX_IFACES], txPps[MAX_IFACES];
+    float dropPs[MAX_IFACES], errPs[MAX_IFACES];    // rx + tx
+} NetSample;
+
+// Recent throughput of every interface, for the sparklines
+typedef struct {
+    int count;
+    unsigned long samples;
+    char name[MAX_IFACES][IFACE_NAME_LEN];
+    float rx[MAX_IFACES][NET_SPARK_LEN], tx[MAX_IFACES][NET_SPARK_LEN];
+} NetHistory;
+
+// Function prototypes
+int netInit(NetCollector *net);
+void storeNetArr(NetCollector *net, NetSnapshot *snapshot);
+void netFree(NetCollector *net);
+void calculateNetRates(const NetSnapshot *prev, const NetSnapshot *curr, NetSample *sample);
+void storeNetSamples(SampleClock *clock, SampleRing *netRing);
+void netHistoryPush(NetHistory *history, const NetSample *sample);
+void printNet(const NetSample *sample, const NetHistory *history);
+
+#endif // NETDEV_H
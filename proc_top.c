@@ -0,0 +1,328 @@
+#define _GNU_SOURCE
+
+#include "proc_top.h"
+#include <fcntl.h>
+
+#define PID_TABLE_MASK (PID_TABLE_SIZE - 1)
+
+// Opens /proc once and raises the descriptor limit so most PIDs keep their file open
+int topInit(TopCollector *top) {
+    memset(top, 0, sizeof(TopCollector));
+    top->proc = opendir("/proc");
+    if (!top->proc)
+        return -1;
+
+    top->fdBudget = procReserveFds(TOP_FD_SHARE);
+    top->useStat = access("/proc/self/schedstat", R_OK) != 0;
+    top->pageKb = sysconf(_SC_PAGESIZE) / 1024;
+    top->tickNs = 1000000000L / sysconf(_SC_CLK_TCK);
+    return 0;
+}
+
+// Finds the entry of pid, optionally claiming a slot for it; *created is set for new entries
+static PidEntry *pidLookup(TopCollector *top, int pid, int *created) {
+    uint32_t i = ((uint32_t)pid * 2654435761u) >> (32 - PID_TABLE_BITS);
+    PidEntry *reuse = NULL;
+
+    for (;;) {
+        PidEntry *entry = &top->table[i];
+
+        if (entry->pid == pid)
+            return entry;
+        if (entry->pid == -1 && !reuse)
+            reuse = entry;
+        if (entry->pid == 0) {
+            if (reuse) {
+                top->deleted--;
+                entry = reuse;
+            }
+            memset(entry, 0, sizeof(PidEntry));
+            entry->pid = pid;
+            entry->fd = -1;
+            top->used++;
+            *created = 1;
+            return entry;
+        }
+        i = (i + 1) & PID_TABLE_MASK;
+    }
+}
+
+// Reads /proc/PID/name through the open /proc handle; returns bytes read or -1
+static ssize_t readPidFile(TopCollector *top, int pid, const char *name, char *buf, size_t size, int *keepFd) {
+    char path[32];
+    snprintf(path, sizeof(path), "%d/%s", pid, name);
+
+    int fd = openat(dirfd(top->proc), path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return -1;
+
+    ssize_t n = pread(fd, buf, size - 1, 0);
+    buf[n > 0 ? n : 0] = '\0';
+
+    if (keepFd && n > 0 && top->openFds < top->fdBudget) {
+        *keepFd = fd;
+        top->openFds++;
+    } else
+        close(fd);
+    return n;
+}
+
+// Releases the cached descriptor of an entry
+static void dropFd(TopCollector *top, PidEntry *entry) {
+    if (entry->fd != -1) {
+        close(entry->fd);
+        top->openFds--;
+        entry->fd = -1;
+    }
+}
+
+// Reads the cumulative CPU time of a PID; returns -1 if the process is gone
+static int readRuntime(TopCollector *top, PidEntry *entry, uint64_t *runtimeNs) {
+    char buf[512];
+    ssize_t n;
+
+    if (entry->fd != -1) {
+        n = pread(entry->fd, buf, sizeof(buf) - 1, 0);
+        buf[n > 0 ? n : 0] = '\0';
+    } else
+        n = readPidFile(top, entry->pid, top->useStat ? "stat" : "schedstat", buf, sizeof(buf), &entry->fd);
+
+    if (n <= 0)
+        return -1;
+
+    if (!top->useStat)
+        return procScanU64(buf, runtimeNs) ? 0 : -1;
+
+    // stat: skip "pid (comm) state" then fields 4..13 to reach utime and stime
+    const char *p = strrchr(buf, ')');
+    uint64_t utime = 0, stime = 0;
+    if (!p)
+        return -1;
+    p++;
+    for (int k = 3; k <= 13 && p; k++)
+        p = procSkipField(p);     // tpgid (field 8) is -1 for most daemons
+    if (!p || !(p = procScanU64(p, &utime)) || !procScanU64(p, &stime))
+        return -1;
+
+    *runtimeNs = (utime + stime) * (uint64_t)top->tickNs;
+    return 0;
+}
+
+// Reads the resident set size of a PID in pages
+static uint64_t readRss(TopCollector *top, int pid) {
+    char buf[128];
+    uint64_t size = 0, resident = 0;
+    const char *p;
+
+    if (readPidFile(top, pid, "statm", buf, sizeof(buf), NULL) <= 0)
+        return 0;
+    if ((p = procScanU64(buf, &size)) != NULL)
+        procScanU64(p, &resident);
+    return resident;
+}
+
+// Sets up the entry of a PID seen for the first time
+static int initEntry(TopCollector *top, PidEntry *entry) {
+    char comm[64];
+
+    dropFd(top, entry);
+    if (readPidFile(top, entry->pid, "comm", comm, sizeof(comm), NULL) > 0) {
+        size_t len = strcspn(comm, "\n");
+        if (len >= sizeof(entry->comm))
+            len = sizeof(entry->comm) - 1;
+        memcpy(entry->comm, comm, len);
+        entry->comm[len] = '\0';
+    }
+    entry->rssPages = readRss(top, entry->pid);
+    return readRuntime(top, entry, &entry->runtimeNs);
+}
+
+// Offers a process to the top-N min-heap (root = smallest CPU%)
+static void heapOffer(TopProc *heap, int *count, const TopProc *proc) {
+    int i;
+
+    if (*count < TOP_N) {
+        i = (*count)++;
+        while (i > 0 && heap[(i - 1) / 2].cpuPercent > proc->cpuPercent) {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i] = *proc;
+        return;
+    }
+
+    i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= TOP_N)
+            break;
+        if (child + 1 < TOP_N && heap[child + 1].cpuPercent < heap[child].cpuPercent)
+            child++;
+        if (heap[child].cpuPercent >= proc->cpuPercent)
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = *proc;
+}
+
+// Re-inserts the live entries once deleted slots make probe chains long
+static void rebuildTable(TopCollector *top) {
+    PidEntry *live = malloc(sizeof(PidEntry) * top->used);
+    int n = 0;
+
+    if (!live)
+        return;
+    for (int i = 0; i < PID_TABLE_SIZE; i++)
+        if (top->table[i].pid > 0)
+            live[n++] = top->table[i];
+
+    memset(top->table, 0, sizeof(top->table));
+    top->used = top->deleted = 0;
+
+    for (int i = 0; i < n; i++) {
+        int created = 0;
+        *pidLookup(top, live[i].pid, &created) = live[i];
+    }
+    free(live);
+}
+
+// Scans /proc once and fills sample with the top consumers since the previous scan.
+// Known PIDs cost one pread() of a cached descriptor; RSS is only re-read for PIDs that ran.
+void sampleTop(TopCollector *top, TopSample *sample) {
+    uint64_t now = monotonicNs();
+    double elapsedNs = top->lastScanNs ? (double)(now - top->lastScanNs) : 0.0;
+    struct dirent *dent;
+    int count = 0, tracked = 0;
+
+    top->generation++;
+    rewinddir(top->proc);
+
+    while ((dent = readdir(top->proc)) != NULL) {
+        if (dent->d_name[0] < '1' || dent->d_name[0] > '9')
+            continue;
+
+        int pid = atoi(dent->d_name), created = 0;
+        if (top->used + top->deleted >= PID_TABLE_SIZE * 3 / 4)
+            break;  // table full; the remaining PIDs are skipped this scan
+
+        PidEntry *entry = pidLookup(top, pid, &created);
+        uint64_t runtimeNs;
+        long rssDeltaKb = 0;
+
+        entry->seen = top->generation;
+        tracked++;
+
+        if (created) {
+            if (initEntry(top, entry) == -1)
+                continue;
+            runtimeNs = entry->runtimeNs;
+        } else if (readRuntime(top, entry, &runtimeNs) == -1) {
+            // Cached descriptor belongs to an exited process; this PID was reused
+            if (initEntry(top, entry) == -1)
+                continue;
+            runtimeNs = entry->runtimeNs;
+        } else if (runtimeNs < entry->runtimeNs) {
+            // Runtime went backwards: the PID was reused by a process read without a
+            // cached descriptor (fd budget exhausted). Reseed it; it shows 0% this scan
+            if (initEntry(top, entry) == -1)
+                continue;
+            runtimeNs = entry->runtimeNs;
+        } else if (runtimeNs != entry->runtimeNs) {
+            uint64_t rss = readRss(top, pid);
+            rssDeltaKb = ((long)rss - (long)entry->rssPages) * top->pageKb;
+            entry->rssPages = rss;
+        }
+
+        float cpu = elapsedNs > 0 ? (float)((runtimeNs - entry->runtimeNs) / elapsedNs * 100.0) : 0.0f;
+        entry->runtimeNs = runtimeNs;
+
+        if (count < TOP_N || cpu > sample->procs[0].cpuPercent) {
+            TopProc proc;
+            proc.pid = pid;
+            memcpy(proc.comm, entry->comm, sizeof(proc.comm));
+            proc.cpuPercent = cpu;
+            proc.rssKb = entry->rssPages * top->pageKb;
+            proc.rssDeltaKb = rssDeltaKb;
+            heapOffer(sample->procs, &count, &proc);
+        }
+    }
+
+    // Forget PIDs that were not listed this time
+    for (int i = 0; i < PID_TABLE_SIZE; i++) {
+        PidEntry *entry = &top->table[i];
+        if (entry->pid > 0 && entry->seen != top->generation) {
+            dropFd(top, entry);
+            entry->pid = -1;
+            top->used--;
+            top->deleted++;
+        }
+    }
+    if (top->deleted > PID_TABLE_SIZE / 4)
+        rebuildTable(top);
+
+    // Heap to descending order
+    for (int i = 1; i < count; i++) {
+        TopProc proc = sample->procs[i];
+        int j = i - 1;
+        while (j >= 0 && (sample->procs[j].cpuPercent < proc.cpuPercent ||
+                          (sample->procs[j].cpuPercent == proc.cpuPercent && sample->procs[j].rssKb < proc.rssKb))) {
+            sample->procs[j + 1] = sample->procs[j];
+            j--;
+        }
+        sample->procs[j + 1] = proc;
+    }
+
+    sample->count = count;
+    sample->tracked = tracked;
+    sample->header.timestampNs = now;
+    top->lastScanNs = now;
+}
+
+// Takes a baseline scan on tick 0, then pushes the top consumers on every tick
+void storeTopSamples(SampleClock *clock, SampleRing *topRing) {
+    collectorRun("top", clock, topRing);
+}
+
+// Closes the cached descriptors and /proc
+void topFree(TopCollector *top) {
+    for (int i = 0; i < PID_TABLE_SIZE; i++)
+        if (top->table[i].pid > 0)
+            dropFd(top, &top->table[i]);
+    procReleaseFds(top->fdBudget);
+    top->fdBudget = 0;
+    if (top->proc)
+        closedir(top->proc);
+    top->proc = NULL;
+}
+
+static int topCollectorInit(void *state) {
+    return topInit(state);
+}
+
+static int topCollectorSample(void *state, void *out) {
+    sampleTop(state, out);
+    return 0;
+}
+
+static void topCollectorTeardown(void *state) {
+    topFree(state);
+}
+
+const CollectorOps topCollector = {
+    .name = "top", .stateSize = sizeof(TopCollector), .sampleSize = sizeof(TopSample),
+    .latencyPhase = LAT_COLLECT_TOP, .init = topCollectorInit, .sample = topCollectorSample,
+    .teardown = topCollectorTeardown,
+};
+
+// Prints the top consumers table
+void printTopProcs(const TopSample *sample) {
+    renderf("### Top processes ### (%d tracked)\n", sample->tracked);
+    renderf("    PID COMMAND           CPU%%    RSS MB  dRSS kB\n");
+
+    for (int i = 0; i < sample->count; i++) {
+        const TopProc *proc = &sample->procs[i];
+        renderf("%7d %-16s %6.2f %9.1f %8ld\n", proc->pid, proc->comm, proc->cpuPercent,
+               proc->rssKb / 1024.0, proc->rssDeltaKb);
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef PROC_TOP_H
+#define PROC_TOP_H
+
+#include <dirent.h>
+#include "stats_functions.h"
+
+#define TOP_N 20
+#define PID_TABLE_BITS 16
+#define PID_TABLE_SIZE (1 << PID_TABLE_BITS)
+#define TOP_FD_SHARE 60                 // % of the process-wide descriptor pool (see procReserveFds)
+
+// Per-PID state kept between scans
+typedef struct {
+    int pid;                // 0 = empty slot, -1 = deleted
+    int fd;                 // cached /proc/PID/schedstat (or stat) descriptor, -1 if none
+    uint64_t runtimeNs;     // CPU time at the previous scan
+    uint64_t rssPages;
+    uint32_t seen;          // generation of the last scan that listed the PID
+    char comm[16];
+} PidEntry;
+
+typedef struct {
+    int pid;
+    char comm[16];
+    float cpuPercent;
+    long rssKb, rssDeltaKb;
+} TopProc;
+
+// Top consumers of one interval, largest CPU% first
+typedef struct {
+    SampleHeader header;
+    int count;
+    int tracked;            // processes seen in this scan
+    TopProc procs[TOP_N];
+} TopSample;
+
+typedef struct {
+    DIR *proc;              // /proc, rewound rather than reopened every scan
+    int useStat;            // no schedstat on this kernel: fall back to utime+stime
+    int openFds, fdBudget;
+    int used, deleted;
+    uint32_t generation;
+    uint64_t lastScanNs;
+    long pageKb, tickNs;
+    PidEntry table[PID_TABLE_SIZE];
+} TopCollector;
+
+// Function prototypes
+int topInit(TopCollector *top);
+void sampleTop(TopCollector *top, TopSample *sample);
+void storeTopSamples(SampleClock *clock, SampleRing *topRing);
+void topFree(TopCollector *top);
+void printTopProcs(const TopSample *sample);
+
+#endif // PROC_TOP_H
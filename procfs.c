@@ -0,0 +1,84 @@
+#define _GNU_SOURCE
+
+#include "procfs.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+// Opens path once; buf (cap bytes) receives the contents on every procRead
+int procOpen(ProcFile *file, const char *path, char *buf, size_t cap) {
+    file->fd = open(path, O_RDONLY | O_CLOEXEC);
+    file->buf = buf;
+    file->cap = cap;
+    file->len = 0;
+    buf[0] = '\0';
+    return file->fd == -1 ? -1 : 0;
+}
+
+// Re-reads the file from offset 0 until EOF or the buffer is full; NUL-terminates it
+int procRead(ProcFile *file) {
+    size_t len = 0;
+
+    while (len < file->cap - 1) {
+        ssize_t n = pread(file->fd, file->buf + len, file->cap - 1 - len, len);
+        if (n < 0)
+            return -1;
+        if (n == 0)
+            break;
+        len += n;
+    }
+
+    file->buf[len] = '\0';
+    file->len = len;
+    return 0;
+}
+
+// Closes the underlying descriptor
+void procClose(ProcFile *file) {
+    if (file->fd != -1)
+        close(file->fd);
+    file->fd = -1;
+}
+
+// Descriptors of the raised limit the caching collectors may share, -1 until first reserved
+static int fdPool = -1;
+static int fdReserved;
+
+// Raises the soft descriptor limit towards the hard one (at most 65536) for
+// collectors that keep a file per PID, group or peer open; returns the usable limit
+int procRaiseFdLimit(void) {
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == -1)
+        return 0;
+
+    rlim_t wanted = limit.rlim_max < 65536 ? limit.rlim_max : 65536;
+    if (limit.rlim_cur < wanted) {
+        limit.rlim_cur = wanted;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    return limit.rlim_cur < 65536 ? (int)limit.rlim_cur : 65536;
+}
+
+// Reserves percent of the process-wide descriptor pool (the raised limit minus
+// PROC_FD_RESERVE for sockets, timers and plain files). Collectors running in one
+// process (the loop engine) so split the headroom instead of each claiming all of it.
+// Returns the number of descriptors granted
+int procReserveFds(int percent) {
+    if (fdPool == -1) {
+        int usable = procRaiseFdLimit();
+        fdPool = usable > PROC_FD_RESERVE ? usable - PROC_FD_RESERVE : 0;
+    }
+
+    int share = fdPool * percent / 100;
+    if (share > fdPool - fdReserved)
+        share = fdPool - fdReserved;
+    fdReserved += share;
+    return share;
+}
+
+// Returns descriptors granted by procReserveFds to the pool
+void procReleaseFds(int count) {
+    fdReserved -= count;
+}
@@ -0,0 +1,66 @@
+#ifndef PROCFS_H
+#define PROCFS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A /proc file kept open for the lifetime of the collector. procRead()
+// re-reads it with pread() at offset 0 into a caller-provided buffer, so a
+// sample costs no open/close, no stdio and no heap allocation.
+typedef struct {
+    int fd;
+    char *buf;
+    size_t cap;
+    size_t len;
+} ProcFile;
+
+#define PROC_FD_RESERVE 256     // descriptors kept out of the collectors' pool
+
+// Function prototypes
+int procOpen(ProcFile *file, const char *path, char *buf, size_t cap);
+int procRead(ProcFile *file);
+void procClose(ProcFile *file);
+int procRaiseFdLimit(void);
+int procReserveFds(int percent);
+void procReleaseFds(int count);
+
+// Hand-written scanners over a NUL-terminated buffer (no locale, no allocation)
+static inline const char *procSkipSpaces(const char *p) {
+    while (*p == ' ' || *p == '\t')
+        p++;
+    return p;
+}
+
+static inline const char *procSkipLine(const char *p) {
+    while (*p && *p != '\n')
+        p++;
+    return *p ? p + 1 : p;
+}
+
+// Skips one blank-separated field of any form (e.g. a negative number); returns NULL if there is none
+static inline const char *procSkipField(const char *p) {
+    p = procSkipSpaces(p);
+    if (!*p || *p == '\n')
+        return NULL;
+
+    while (*p && *p != ' ' && *p != '\t' && *p != '\n')
+        p++;
+    return p;
+}
+
+// Parses an unsigned decimal after optional blanks; returns NULL if there is none
+static inline const char *procScanU64(const char *p, uint64_t *value) {
+    uint64_t v = 0;
+
+    p = procSkipSpaces(p);
+    if (*p < '0' || *p > '9')
+        return NULL;
+
+    while (*p >= '0' && *p <= '9')
+        v = v * 10 + (uint64_t)(*p++ - '0');
+
+    *value = v;
+    return p;
+}
+
+#endif // PROCFS_H
@@ -0,0 +1,153 @@
+#define _GNU_SOURCE
+
+#include "psi.h"
+
+static const char *psiNames[PSI_RESOURCES] = { "cpu", "memory", "io" };
+
+// Parses "key=12.34" at p into value; returns the position after it or NULL
+static const char *scanAverage(const char *p, const char *key, float *value) {
+    uint64_t whole = 0, frac = 0;
+    size_t len = strlen(key);
+
+    p = procSkipSpaces(p);
+    if (strncmp(p, key, len) != 0 || !(p = procScanU64(p + len, &whole)))
+        return NULL;
+    if (*p == '.') {
+        const char *digits = p + 1;
+        p = procScanU64(digits, &frac);
+        if (!p)
+            return NULL;
+        *value = whole + frac / (p - digits == 1 ? 10.0f : 100.0f);
+    } else
+        *value = whole;
+    return p;
+}
+
+// Parses a "some ..." or "full ..." line (also the format of cgroup *.pressure files); returns 0 on success
+int parsePsiLine(const char *p, const char *kind, PsiLine *line) {
+    float avg300;
+
+    if (strncmp(p, kind, 4) != 0)
+        return -1;
+    p += 4;
+    if (!(p = scanAverage(p, "avg10=", &line->avg10)) || !(p = scanAverage(p, "avg60=", &line->avg60)) ||
+        !(p = scanAverage(p, "avg300=", &avg300)))
+        return -1;
+
+    p = procSkipSpaces(p);
+    if (strncmp(p, "total=", 6) != 0 || !procScanU64(p + 6, &line->totalUs))
+        return -1;
+    return 0;
+}
+
+// Opens the three pressure files for the lifetime of the collector; returns -1 on kernels without PSI
+int psiInit(PsiCollector *psi) {
+    int failed = 0;
+
+    for (int r = 0; r < PSI_RESOURCES; r++) {
+        char path[32];
+
+        snprintf(path, sizeof(path), "/proc/pressure/%s", psiNames[r]);
+        failed |= procOpen(&psi->files[r], path, psi->bufs[r], sizeof(psi->bufs[r])) == -1;
+    }
+    return failed ? -1 : 0;
+}
+
+void psiFree(PsiCollector *psi) {
+    for (int r = 0; r < PSI_RESOURCES; r++)
+        procClose(&psi->files[r]);
+}
+
+// Reads the cumulative totals and averages of the three pressure files into a snapshot
+// (deltas are left to calculatePsiDeltas). Returns -1 on kernels without PSI
+int samplePsi(PsiCollector *psi, PsiSample *snapshot) {
+    memset(snapshot, 0, sizeof(PsiSample));
+    snapshot->header.timestampNs = monotonicNs();
+
+    for (int r = 0; r < PSI_RESOURCES; r++) {
+        ProcFile *file = &psi->files[r];
+
+        if (file->fd == -1 || procRead(file) == -1 || parsePsiLine(file->buf, "some", &snapshot->some[r]) == -1)
+            return -1;
+        // "full" is missing for cpu on kernels older than 5.13
+        if (parsePsiLine(procSkipLine(file->buf), "full", &snapshot->full[r]) == -1)
+            memset(&snapshot->full[r], 0, sizeof(PsiLine));
+    }
+    snapshot->available = 1;
+    return 0;
+}
+
+// Stall time of one counter between two snapshots; a counter that went backwards counts as 0
+static uint64_t stallDelta(uint64_t curr, uint64_t prev) {
+    return curr < prev ? 0 : curr - prev;
+}
+
+// Fills sample with the averages of curr and the stall time accumulated since prev
+void calculatePsiDeltas(const PsiSample *prev, const PsiSample *curr, PsiSample *sample) {
+    *sample = *curr;
+    sample->intervalNs = curr->header.timestampNs - prev->header.timestampNs;
+    if (!prev->available || !curr->available)
+        return;
+
+    for (int r = 0; r < PSI_RESOURCES; r++) {
+        sample->some[r].deltaUs = stallDelta(curr->some[r].totalUs, prev->some[r].totalUs);
+        sample->full[r].deltaUs = stallDelta(curr->full[r].totalUs, prev->full[r].totalUs);
+    }
+}
+
+// Takes a baseline on tick 0, then pushes the pressure of every interval
+void storePsiSamples(SampleClock *clock, SampleRing *psiRing) {
+    collectorRun("psi", clock, psiRing);
+}
+
+// A kernel without PSI is reported through PsiSample.available, never as an error
+static int psiCollectorInit(void *state) {
+    psiInit(state);
+    return 0;
+}
+
+static int psiCollectorSample(void *state, void *out) {
+    samplePsi(state, out);
+    return 0;
+}
+
+static void psiCollectorDiff(void *state, const void *prev, const void *curr, void *out) {
+    (void)state;
+    calculatePsiDeltas(prev, curr, out);
+}
+
+static void psiCollectorTeardown(void *state) {
+    psiFree(state);
+}
+
+const CollectorOps psiCollector = {
+    .name = "psi", .stateSize = sizeof(PsiCollector), .snapshotSize = sizeof(PsiSample),
+    .sampleSize = sizeof(PsiSample), .latencyPhase = LAT_COLLECT_PSI, .init = psiCollectorInit,
+    .sample = psiCollectorSample, .diff = psiCollectorDiff, .teardown = psiCollectorTeardown,
+};
+
+// Formats the stall time of one interval and its share of the interval
+static void formatStall(const PsiLine *line, uint64_t intervalNs, char *out, size_t size) {
+    double percent = intervalNs ? line->deltaUs * 1000.0 / intervalNs * 100.0 : 0.0;
+    snprintf(out, size, "%7.2f ms %5.1f%%", line->deltaUs / 1000.0, percent);
+}
+
+// Prints some/full averages and the stall time of the last interval per resource
+void printPsi(const PsiSample *sample) {
+    char some[32], full[32];
+
+    renderf("### Pressure ### (avg10 avg60, stalled this interval)\n");
+    if (!sample->available) {
+        renderf("PSI not available on this kernel\n");
+        return;
+    }
+
+    renderf(" resource  some:  avg10  avg60       stalled      full:  avg10  avg60       stalled\n");
+    for (int r = 0; r < PSI_RESOURCES; r++) {
+        formatStall(&sample->some[r], sample->intervalNs, some, sizeof(some));
+        formatStall(&sample->full[r], sample->intervalNs, full, sizeof(full));
+        renderf(" %-8s       %6.2f %6.2f %s        %6.2f %6.2f %s\n", psiNames[r],
+                sample->some[r].avg10, sample->some[r].avg60, some,
+                sample->full[r].avg10, sample->full[r].avg60, full);
+    }
+}
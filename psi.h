@@ -0,0 +1,38 @@
+#ifndef PSI_H
+#define PSI_H
+
+#include "stats_functions.h"
+
+#define PSI_RESOURCES 3             // cpu, memory, io
+
+// One "some" or "full" line of a /proc/pressure file
+typedef struct {
+    float avg10, avg60;
+    uint64_t totalUs;               // cumulative stall time
+    uint64_t deltaUs;               // stall time during the last interval
+} PsiLine;
+
+// Stall information of one interval; available is 0 on kernels without PSI
+typedef struct {
+    SampleHeader header;
+    uint64_t intervalNs;
+    int available;
+    PsiLine some[PSI_RESOURCES], full[PSI_RESOURCES];
+} PsiSample;
+
+// State of the psi collector: the three pressure files kept open between snapshots
+typedef struct {
+    ProcFile files[PSI_RESOURCES];
+    char bufs[PSI_RESOURCES][256];
+} PsiCollector;
+
+// Function prototypes
+int parsePsiLine(const char *p, const char *kind, PsiLine *line);
+int psiInit(PsiCollector *psi);
+int samplePsi(PsiCollector *psi, PsiSample *snapshot);
+void calculatePsiDeltas(const PsiSample *prev, const PsiSample *curr, PsiSample *sample);
+void psiFree(PsiCollector *psi);
+void storePsiSamples(SampleClock *clock, SampleRing *psiRing);
+void printPsi(const PsiSample *sample);
+
+#endif // PSI_H
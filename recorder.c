@@ -0,0 +1,445 @@
+#define _GNU_SOURCE
+
+#include "recorder.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Bytes needed for a file holding capacity records
+static size_t recordFileSize(const RecordHeader *header, uint64_t capacity) {
+    return header->dataOffset + capacity * header->recordSize;
+}
+
+// Reserves disk blocks for the file and maps it shared
+static int recorderMap(Recorder *rec, size_t size) {
+    int err = posix_fallocate(rec->fd, 0, size);
+    if (err == EOPNOTSUPP || err == EINVAL)
+        err = ftruncate(rec->fd, size) == -1 ? errno : 0;
+    if (err) {
+        errno = err;
+        return -1;
+    }
+
+    void *map = rec->map
+        ? mremap(rec->map, rec->mapSize, size, MREMAP_MAYMOVE)
+        : mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, rec->fd, 0);
+    if (map == MAP_FAILED)
+        return -1;
+
+    rec->map = map;
+    rec->mapSize = size;
+    rec->header = map;
+    return 0;
+}
+
+// Where the rollup aggregates of a record start (right after its cpuBusy rows)
+static size_t rollupOffset(const RecordHeader *header) {
+    return sizeof(RecordSample) + header->cpuRows * sizeof(float);
+}
+
+// Creates path with a header, an empty index and room for capacity records;
+// rollups (may be NULL) fixes the windows every record carries aggregates for.
+// fastIntervalNs marks an --adaptive recording (records are then spaced between it and intervalNs).
+// With chunked set the records are compressed (RECORD_MAGIC_CHUNKED layout).
+int recorderOpen(Recorder *rec, const char *path, uint64_t intervalNs, uint64_t fastIntervalNs, uint64_t capacity,
+                 const Rollups *rollups, int chunked) {
+    RecordHeader header;
+    int cpuRows = sysconf(_SC_NPROCESSORS_CONF) + 1;
+
+    if (cpuRows > MAX_CPUS + 1)
+        cpuRows = MAX_CPUS + 1;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, chunked ? RECORD_MAGIC_CHUNKED : RECORD_MAGIC, sizeof(header.magic));
+    header.version = RECORD_VERSION;
+    header.cpuRows = cpuRows;
+    header.rollupWindows = rollups ? rollups->count : 0;
+    for (uint32_t w = 0; w < header.rollupWindows; w++)
+        header.rollupWindowNs[w] = rollups->windows[w].lengthNs;
+    header.recordSize = (rollupOffset(&header) + header.rollupWindows * ROLLUP_METRICS * sizeof(RollupStats) + 7) & ~7u;
+    header.indexStride = 16;
+    header.capacity = capacity ? capacity : RECORD_INITIAL_CAPACITY;
+    header.intervalNs = intervalNs;
+    header.fastIntervalNs = fastIntervalNs;
+    header.indexOffset = sizeof(RecordHeader);
+    header.dataOffset = header.indexOffset + RECORD_INDEX_SLOTS * sizeof(RecordIndexEntry);
+
+    memset(rec, 0, sizeof(Recorder));
+    rec->chunked = chunked;
+    if (chunked) {
+        // Room for a quarter of the raw size; the data area doubles when it fills
+        if (codecInit(&rec->codec, header.recordSize, intervalNs) == -1 ||
+            !(rec->scratch = malloc(header.recordSize))) {
+            codecFree(&rec->codec);
+            return -1;
+        }
+        header.indexStride = 1;
+        header.capacity = header.capacity * header.recordSize / 4 + codecMaxRecordBytes(&rec->codec);
+        header.capacity = (header.capacity + sizeof(ChunkHeader) + 7) & ~7ull;
+    }
+
+    rec->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    size_t size = chunked ? header.dataOffset + header.capacity : recordFileSize(&header, header.capacity);
+    if (rec->fd == -1 || recorderMap(rec, size) == -1) {
+        if (rec->fd != -1)
+            close(rec->fd);
+        codecFree(&rec->codec);
+        free(rec->scratch);
+        return -1;
+    }
+
+    memcpy(rec->header, &header, sizeof(header));
+    return 0;
+}
+
+// Halves the index by keeping every other entry and doubling the stride
+static void recorderCompactIndex(RecordHeader *header, RecordIndexEntry *index) {
+    for (uint32_t i = 0; i < header->indexCount / 2; i++)
+        index[i] = index[i * 2];
+    header->indexCount /= 2;
+    header->indexStride *= 2;
+}
+
+// Adds an index entry for every indexStride-th record (or chunk), compacting the index when full
+static void recorderIndex(Recorder *rec, uint64_t ordinal, uint64_t timestampNs, uint64_t position) {
+    RecordHeader *header = rec->header;
+    RecordIndexEntry *index = (RecordIndexEntry *)(rec->map + header->indexOffset);
+
+    if (ordinal % header->indexStride != 0)
+        return;
+    if (header->indexCount == RECORD_INDEX_SLOTS)
+        recorderCompactIndex(header, index);
+    if (ordinal % header->indexStride == 0) {
+        index[header->indexCount].timestampNs = timestampNs;
+        index[header->indexCount].record = position;
+        header->indexCount++;
+    }
+}
+
+// Bytes the chunk at offset occupies, header and padding included
+static uint64_t chunkSpan(const ChunkHeader *chunk) {
+    return sizeof(ChunkHeader) + ((chunk->bytes + 7) & ~7ull);
+}
+
+// Compresses the scratch record into the open chunk, starting a new chunk when it is full
+static int recorderEncode(Recorder *rec, const RecordSample *record) {
+    RecordHeader *header = rec->header;
+    ChunkHeader *chunk = (ChunkHeader *)(rec->map + header->dataOffset + rec->chunkOffset);
+
+    if (rec->codec.records == CODEC_CHUNK_RECORDS) {
+        rec->chunkOffset += chunkSpan(chunk);
+        rec->chunks++;
+        codecReset(&rec->codec);
+    }
+
+    uint64_t need = rec->chunkOffset + sizeof(ChunkHeader) + (rec->codec.bits + 7) / 8 +
+                    codecMaxRecordBytes(&rec->codec) + 8;
+    if (need > header->capacity) {
+        uint64_t capacity = header->capacity * 2;
+        while (capacity < need)
+            capacity *= 2;
+        if (recorderMap(rec, header->dataOffset + capacity) == -1)
+            return -1;
+        header = rec->header;
+        header->capacity = capacity;
+    }
+
+    chunk = (ChunkHeader *)(rec->map + header->dataOffset + rec->chunkOffset);
+    if (rec->codec.records == 0) {
+        chunk->timestampNs = record->timestampNs;
+        recorderIndex(rec, rec->chunks, record->timestampNs, rec->chunkOffset);
+    }
+
+    codecEncode(&rec->codec, (unsigned char *)(chunk + 1), (const unsigned char *)record);
+    chunk->bytes = (uint32_t)((rec->codec.bits + 7) / 8);
+    chunk->records = rec->codec.records;
+    return 0;
+}
+
+// Appends one record; count is published last so a crash never exposes a torn record
+int recorderAppend(Recorder *rec, const MemSample *mem, const CpuSample *cpu, int sessions, const Rollups *rollups) {
+    RecordHeader *header = rec->header;
+    uint64_t n = header->count;
+
+    if (!rec->chunked && n == header->capacity) {
+        if (recorderMap(rec, recordFileSize(header, header->capacity * 2)) == -1)
+            return -1;
+        header = rec->header;
+        header->capacity *= 2;
+    }
+
+    RecordSample *record = rec->chunked
+        ? (RecordSample *)rec->scratch
+        : (RecordSample *)(rec->map + header->dataOffset + n * header->recordSize);
+    memset(record, 0, header->recordSize);
+
+    record->timestampNs = mem ? mem->header.timestampNs : cpu ? cpu->header.timestampNs : monotonicNs();
+    record->tick = mem ? mem->header.tick : cpu ? cpu->header.tick : 0;
+    record->sessions = sessions;
+
+    if (mem) {
+        record->physUsedGb = mem->physUsedGb;
+        record->physTotalGb = mem->physTotalGb;
+        record->virtUsedGb = mem->virtUsedGb;
+        record->virtTotalGb = mem->virtTotalGb;
+    }
+
+    if (cpu) {
+        uint32_t rows = (uint32_t)cpu->rows < header->cpuRows ? (uint32_t)cpu->rows : header->cpuRows;
+        memcpy(record->cpuBusy, cpu->busy, rows * sizeof(float));
+        record->cpuIowait = cpu->iowait[0];
+        record->cpuSteal = cpu->steal[0];
+        record->cpuIrq = cpu->irq[0];
+    }
+
+    if (rollups && header->rollupWindows)
+        memcpy((unsigned char *)record + rollupOffset(header), rollups->stats,
+               header->rollupWindows * ROLLUP_METRICS * sizeof(RollupStats));
+
+    if (n == 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        header->startRealtimeNs = (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+    }
+
+    if (!rec->chunked)
+        recorderIndex(rec, n, record->timestampNs, n);
+    else if (recorderEncode(rec, record) == -1)
+        return -1;
+    header = rec->header;
+
+    __atomic_store_n(&header->count, n + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// Bytes of record data written so far
+uint64_t recorderDataBytes(const Recorder *rec) {
+    const RecordHeader *header = rec->header;
+
+    if (!rec->chunked)
+        return header->count * header->recordSize;
+    if (header->count == 0)
+        return 0;
+    return rec->chunkOffset + chunkSpan((const ChunkHeader *)(rec->map + header->dataOffset + rec->chunkOffset));
+}
+
+// Flushes and unmaps the file; a chunked file gives back its unused preallocation
+void recorderClose(Recorder *rec) {
+    if (!rec->map)
+        return;
+
+    if (rec->chunked) {
+        uint64_t used = recorderDataBytes(rec);
+        size_t size = rec->header->dataOffset + used;
+        rec->header->capacity = used;
+        msync(rec->map, rec->mapSize, MS_SYNC);
+        munmap(rec->map, rec->mapSize);
+        if (ftruncate(rec->fd, size) == -1)
+            perror("Failed to trim record file");
+        codecFree(&rec->codec);
+        free(rec->scratch);
+    } else {
+        msync(rec->map, rec->mapSize, MS_ASYNC);
+        munmap(rec->map, rec->mapSize);
+    }
+    close(rec->fd);
+    rec->map = NULL;
+}
+
+// Maps an existing record file read-only and validates its header
+int readerOpen(RecordReader *reader, const char *path) {
+    struct stat st;
+
+    memset(reader, 0, sizeof(RecordReader));
+    reader->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (reader->fd == -1 || fstat(reader->fd, &st) == -1)
+        return -1;
+
+    if ((size_t)st.st_size < sizeof(RecordHeader)) {
+        close(reader->fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    reader->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, reader->fd, 0);
+    if (reader->map == MAP_FAILED) {
+        close(reader->fd);
+        return -1;
+    }
+    reader->mapSize = st.st_size;
+    reader->header = (const RecordHeader *)reader->map;
+
+    const RecordHeader *header = reader->header;
+    reader->chunked = memcmp(header->magic, RECORD_MAGIC_CHUNKED, sizeof(header->magic)) == 0;
+    reader->cachedChunk = READER_NO_CHUNK;
+    if ((!reader->chunked && memcmp(header->magic, RECORD_MAGIC, sizeof(header->magic)) != 0) ||
+        header->version < 1 || header->version > RECORD_VERSION ||
+        (header->version == 1 && header->rollupWindows != 0) || header->rollupWindows > ROLLUP_MAX_WINDOWS ||
+        header->cpuRows == 0 || header->cpuRows > CPU_ROWS ||
+        header->recordSize < rollupOffset(header) + header->rollupWindows * ROLLUP_METRICS * sizeof(RollupStats) ||
+        header->indexCount > RECORD_INDEX_SLOTS || header->indexStride == 0 ||
+        header->indexOffset > reader->mapSize ||
+        header->indexCount * sizeof(RecordIndexEntry) > reader->mapSize - header->indexOffset ||
+        header->dataOffset > reader->mapSize ||
+        (!reader->chunked && header->count > (reader->mapSize - header->dataOffset) / header->recordSize)) {
+        readerClose(reader);
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (reader->chunked &&
+        (codecInit(&reader->codec, header->recordSize, header->intervalNs) == -1 ||
+         !(reader->cache = malloc((size_t)CODEC_CHUNK_RECORDS * header->recordSize)))) {
+        readerClose(reader);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    reader->count = __atomic_load_n(&header->count, __ATOMIC_ACQUIRE);
+    madvise((void *)reader->map, reader->mapSize, MADV_SEQUENTIAL);
+    return 0;
+}
+
+// Decodes chunk into the cache: starts from the nearest index entry (or the cached
+// chunk when it is closer) and follows the chunk lengths from there
+static void readerLoadChunk(RecordReader *reader, uint64_t chunk) {
+    const RecordHeader *header = reader->header;
+    const RecordIndexEntry *index = (const RecordIndexEntry *)(reader->map + header->indexOffset);
+    const unsigned char *data = reader->map + header->dataOffset;
+    uint64_t dataSize = reader->mapSize - header->dataOffset;
+    uint64_t entry = chunk / header->indexStride, at = 0, offset = 0;
+
+    if (header->indexCount > 0) {
+        if (entry >= header->indexCount)
+            entry = header->indexCount - 1;
+        at = entry * header->indexStride;
+        offset = index[entry].record;
+    }
+    if (reader->cachedChunk != READER_NO_CHUNK && reader->cachedChunk <= chunk && reader->cachedChunk >= at) {
+        at = reader->cachedChunk;
+        offset = reader->cachedOffset;
+    }
+
+    memset(reader->cache, 0, (size_t)CODEC_CHUNK_RECORDS * header->recordSize);
+    reader->cachedChunk = chunk;
+
+    for (;;) {
+        if (offset + sizeof(ChunkHeader) > dataSize)
+            return;
+        const ChunkHeader *current = (const ChunkHeader *)(data + offset);
+        if (at == chunk) {
+            uint64_t first = chunk * CODEC_CHUNK_RECORDS;
+            uint32_t records = current->records;
+            if (reader->count - first < records)
+                records = (uint32_t)(reader->count - first);
+            if (current->bytes > dataSize - offset - sizeof(ChunkHeader) || records > CODEC_CHUNK_RECORDS)
+                return;
+            reader->cachedOffset = offset;
+            codecReset(&reader->codec);
+            codecDecode(&reader->codec, (const unsigned char *)(current + 1), current->bytes, records, reader->cache);
+            return;
+        }
+        offset += chunkSpan(current);
+        at++;
+    }
+}
+
+// Returns record n (n < reader->count); chunked files decode the chunk holding it on first access
+const RecordSample *readerAt(RecordReader *reader, uint64_t record) {
+    if (!reader->chunked)
+        return (const RecordSample *)(reader->map + reader->header->dataOffset +
+                                      record * reader->header->recordSize);
+
+    uint64_t chunk = record / CODEC_CHUNK_RECORDS;
+    if (chunk != reader->cachedChunk)
+        readerLoadChunk(reader, chunk);
+    return (const RecordSample *)(reader->cache + (record % CODEC_CHUNK_RECORDS) * reader->header->recordSize);
+}
+
+// Finds the first record at or after timestampNs: binary search on the index, then a short scan
+uint64_t readerSeek(RecordReader *reader, uint64_t timestampNs) {
+    const RecordHeader *header = reader->header;
+    const RecordIndexEntry *index = (const RecordIndexEntry *)(reader->map + header->indexOffset);
+    uint32_t lo = 0, hi = header->indexCount;
+
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (index[mid].timestampNs <= timestampNs)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    uint64_t record = lo == 0 ? 0
+        : reader->chunked ? (uint64_t)(lo - 1) * header->indexStride * CODEC_CHUNK_RECORDS
+        : index[lo - 1].record;
+    while (record < reader->count && readerAt(reader, record)->timestampNs < timestampNs)
+        record++;
+    return record;
+}
+
+// Drops the pages of records before the given one so long replays keep a flat footprint
+void readerRelease(const RecordReader *reader, uint64_t record) {
+    long page = sysconf(_SC_PAGESIZE);
+    size_t end = reader->header->dataOffset +
+                 (reader->chunked ? reader->cachedOffset : record * reader->header->recordSize);
+
+    end &= ~((size_t)page - 1);
+    if (end > 0)
+        madvise((void *)reader->map, end, MADV_DONTNEED);
+}
+
+// Expands a record back into the binary samples the renderer consumes
+void readerSamples(const RecordReader *reader, const RecordSample *record, MemSample *mem, CpuSample *cpu) {
+    uint32_t rows = reader->header->cpuRows;
+
+    memset(mem, 0, sizeof(MemSample));
+    mem->header.timestampNs = record->timestampNs;
+    mem->header.tick = record->tick;
+    mem->physUsedGb = record->physUsedGb;
+    mem->physTotalGb = record->physTotalGb;
+    mem->virtUsedGb = record->virtUsedGb;
+    mem->virtTotalGb = record->virtTotalGb;
+
+    memset(cpu, 0, sizeof(CpuSample));
+    cpu->header = mem->header;
+    cpu->intervalNs = reader->header->intervalNs;
+    cpu->rows = rows;
+    for (uint32_t i = 0; i < rows; i++) {
+        cpu->cpuId[i] = (int)i - 1;
+        cpu->busy[i] = record->cpuBusy[i];
+    }
+    cpu->iowait[0] = record->cpuIowait;
+    cpu->steal[0] = record->cpuSteal;
+    cpu->irq[0] = record->cpuIrq;
+}
+
+// Fastest interval of an adaptive recording; 0 for fixed-rate files and versions before 3
+uint64_t readerFastIntervalNs(const RecordReader *reader) {
+    return reader->header->version >= 3 ? reader->header->fastIntervalNs : 0;
+}
+
+// Loads the rollup aggregates stored in a record; leaves rollups->count at 0 for files without them
+void readerRollups(const RecordReader *reader, const RecordSample *record, Rollups *rollups) {
+    const RecordHeader *header = reader->header;
+
+    rollups->count = header->rollupWindows;
+    for (uint32_t w = 0; w < header->rollupWindows; w++)
+        rollups->windows[w].lengthNs = header->rollupWindowNs[w];
+    memcpy(rollups->stats, (const unsigned char *)record + rollupOffset(header),
+           header->rollupWindows * ROLLUP_METRICS * sizeof(RollupStats));
+}
+
+// Unmaps the file
+void readerClose(RecordReader *reader) {
+    if (reader->map && reader->map != MAP_FAILED)
+        munmap((void *)reader->map, reader->mapSize);
+    if (reader->fd != -1)
+        close(reader->fd);
+    codecFree(&reader->codec);
+    free(reader->cache);
+    reader->cache = NULL;
+    reader->map = NULL;
+}
@@ -0,0 +1,102 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "stats_functions.h"
+#include "rollup.h"
+#include "codec.h"
+
+#define RECORD_MAGIC "SYSSTREC"
+#define RECORD_MAGIC_CHUNKED "SYSSTCHK"   // same header, records compressed in chunks (--compress)
+#define RECORD_VERSION 3       // 2: rollup windows in the header, RollupStats after cpuBusy; 3: adaptive rate
+#define RECORD_INDEX_SLOTS 4096     // fixed index size; the stride doubles when it fills
+#define RECORD_INITIAL_CAPACITY 4096
+
+// File layout: RecordHeader | RecordIndexEntry[RECORD_INDEX_SLOTS] | records.
+// Every record has the same width (recordSize), so record n lives at
+// dataOffset + n * recordSize and the file can be read with no parsing.
+// Version 1 files (no rollups) are still read.
+//
+// Chunked files (RECORD_MAGIC_CHUNKED) keep the header and index but store the
+// records as ChunkHeader + bit stream chunks of CODEC_CHUNK_RECORDS records.
+// There capacity counts data bytes, the index points at every indexStride-th
+// chunk (record holds its byte offset from dataOffset) and recordSize is the
+// width a record decodes to.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t cpuRows;           // aggregate row + cores stored in every record
+    uint32_t indexStride;       // one index entry every indexStride records
+    uint32_t indexCount;
+    uint32_t rollupWindows;     // RollupStats blocks per record (0 in version 1 files)
+    uint64_t capacity;          // records the file has room for
+    uint64_t count;             // complete records; updated after each record is written
+    uint64_t intervalNs;
+    uint64_t startRealtimeNs;   // wall clock at the first record, for display
+    uint64_t indexOffset;
+    uint64_t dataOffset;
+    uint64_t rollupWindowNs[ROLLUP_MAX_WINDOWS];    // version 2 only
+    uint64_t fastIntervalNs;    // version 3: fastest interval of an --adaptive recording, 0 for a fixed rate
+} RecordHeader;
+
+typedef struct {
+    uint64_t timestampNs;
+    uint64_t record;
+} RecordIndexEntry;
+
+// One fixed-width sample; cpuBusy holds cpuRows entries (aggregate first), followed
+// by rollupWindows * ROLLUP_METRICS RollupStats (see readerRollups)
+typedef struct {
+    uint64_t timestampNs;
+    uint32_t tick;
+    uint32_t sessions;
+    float physUsedGb, physTotalGb, virtUsedGb, virtTotalGb;
+    float cpuIowait, cpuSteal, cpuIrq;
+    float cpuBusy[];
+} RecordSample;
+
+typedef struct {
+    int fd;
+    unsigned char *map;
+    size_t mapSize;
+    RecordHeader *header;
+    int chunked;
+    ChunkCodec codec;           // state of the open chunk (chunked files only)
+    uint64_t chunks;            // chunks started so far
+    uint64_t chunkOffset;       // offset of the open chunk from dataOffset
+    unsigned char *scratch;     // the record being encoded
+} Recorder;
+
+// Read-only view of a record file; pages are faulted in on demand
+typedef struct {
+    int fd;
+    const unsigned char *map;
+    size_t mapSize;
+    const RecordHeader *header;
+    uint64_t count;             // records visible when the file was opened
+    int chunked;
+    ChunkCodec codec;
+    unsigned char *cache;       // the decoded chunk readerAt() returns records from
+    uint64_t cachedChunk;       // READER_NO_CHUNK when the cache is empty
+    uint64_t cachedOffset;
+} RecordReader;
+
+#define READER_NO_CHUNK UINT64_MAX
+
+// Function prototypes
+int recorderOpen(Recorder *rec, const char *path, uint64_t intervalNs, uint64_t fastIntervalNs, uint64_t capacity,
+                 const Rollups *rollups, int chunked);
+int recorderAppend(Recorder *rec, const MemSample *mem, const CpuSample *cpu, int sessions, const Rollups *rollups);
+uint64_t recorderDataBytes(const Recorder *rec);
+void recorderClose(Recorder *rec);
+
+int readerOpen(RecordReader *reader, const char *path);
+const RecordSample *readerAt(RecordReader *reader, uint64_t record);
+uint64_t readerSeek(RecordReader *reader, uint64_t timestampNs);
+void readerRelease(const RecordReader *reader, uint64_t record);
+void readerSamples(const RecordReader *reader, const RecordSample *record, MemSample *mem, CpuSample *cpu);
+void readerRollups(const RecordReader *reader, const RecordSample *record, Rollups *rollups);
+uint64_t readerFastIntervalNs(const RecordReader *reader);
+void readerClose(RecordReader *reader);
+
+#endif // RECORDER_H
@@ -0,0 +1,182 @@
+#define _GNU_SOURCE
+
+#include "rollup.h"
+
+// Parses a comma-separated list such as "10s,1m,5m"; returns the number of windows or -1
+int parseWindows(const char *text, uint64_t *windowsNs) {
+    char item[32];
+    int count = 0;
+
+    while (*text) {
+        size_t len = strcspn(text, ",");
+        if (len == 0 || len >= sizeof(item) || count == ROLLUP_MAX_WINDOWS)
+            return -1;
+
+        memcpy(item, text, len);
+        item[len] = '\0';
+        if (parseInterval(item, &windowsNs[count++]) == -1)
+            return -1;
+
+        text += len;
+        if (*text == ',')
+            text++;
+    }
+    return count > 0 ? count : -1;
+}
+
+// Allocates every window for the samples it can hold at intervalNs; returns -1 if out of memory
+int rollupInit(Rollups *rollups, const uint64_t *windowsNs, int count, uint64_t intervalNs) {
+    memset(rollups, 0, sizeof(Rollups));
+
+    for (int w = 0; w < count; w++) {
+        RollupWindow *window = &rollups->windows[w];
+        uint64_t capacity = windowsNs[w] / intervalNs + 2;
+
+        window->lengthNs = windowsNs[w];
+        window->capacity = capacity < ROLLUP_MAX_POINTS ? capacity : ROLLUP_MAX_POINTS;
+        window->points = malloc(window->capacity * sizeof(RollupPoint));
+        if (!window->points)
+            return -1;
+        rollups->count++;
+
+        for (int m = 0; m < ROLLUP_METRICS; m++) {
+            window->minDeque[m].items = malloc(window->capacity * sizeof(uint64_t));
+            window->maxDeque[m].items = malloc(window->capacity * sizeof(uint64_t));
+            if (!window->minDeque[m].items || !window->maxDeque[m].items)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+// Releases the buffers of every window
+void rollupFree(Rollups *rollups) {
+    for (int w = 0; w < rollups->count; w++) {
+        RollupWindow *window = &rollups->windows[w];
+        free(window->points);
+        for (int m = 0; m < ROLLUP_METRICS; m++) {
+            free(window->minDeque[m].items);
+            free(window->maxDeque[m].items);
+        }
+    }
+    rollups->count = 0;
+}
+
+static int bucketOf(float percent) {
+    int bucket = (int)(percent * (ROLLUP_BUCKETS / 100.0f));
+    return bucket < 0 ? 0 : bucket >= ROLLUP_BUCKETS ? ROLLUP_BUCKETS - 1 : bucket;
+}
+
+static float pointValue(const RollupWindow *window, uint64_t seq, int metric) {
+    return window->points[seq % window->capacity].value[metric];
+}
+
+// Appends seq to a deque after dropping the entries it dominates (smaller for max, larger for min)
+static void dequePush(const RollupWindow *window, RollupDeque *deque, uint64_t seq, int metric, int keepMax) {
+    float value = pointValue(window, seq, metric);
+
+    while (deque->back > deque->front) {
+        float last = pointValue(window, deque->items[(deque->back - 1) % window->capacity], metric);
+        if (keepMax ? last > value : last < value)
+            break;
+        deque->back--;
+    }
+    deque->items[deque->back++ % window->capacity] = seq;
+}
+
+// Drops the oldest point of a window
+static void evictOldest(RollupWindow *window) {
+    const RollupPoint *point = &window->points[window->first % window->capacity];
+
+    for (int m = 0; m < ROLLUP_METRICS; m++) {
+        window->sum[m] -= point->value[m];
+        window->buckets[m][bucketOf(point->value[m])]--;
+        if (window->minDeque[m].back > window->minDeque[m].front &&
+            window->minDeque[m].items[window->minDeque[m].front % window->capacity] == window->first)
+            window->minDeque[m].front++;
+        if (window->maxDeque[m].back > window->maxDeque[m].front &&
+            window->maxDeque[m].items[window->maxDeque[m].front % window->capacity] == window->first)
+            window->maxDeque[m].front++;
+    }
+    window->first++;
+}
+
+// Reads min/mean/max and p50/p95/p99 of one metric; scale converts % to display units
+static void windowStats(const RollupWindow *window, int metric, float scale, RollupStats *stats) {
+    static const double percentiles[3] = { 0.50, 0.95, 0.99 };
+    float *outputs[3] = { &stats->p50, &stats->p95, &stats->p99 };
+    uint64_t count = window->next - window->first, seen = 0;
+    int p = 0;
+
+    float min = pointValue(window, window->minDeque[metric].items[window->minDeque[metric].front % window->capacity], metric);
+    float max = pointValue(window, window->maxDeque[metric].items[window->maxDeque[metric].front % window->capacity], metric);
+    stats->min = min * scale;
+    stats->max = max * scale;
+    stats->mean = (float)(window->sum[metric] / count) * scale;
+
+    // One pass over the buckets answers all three percentiles
+    for (int b = 0; b < ROLLUP_BUCKETS && p < 3; b++) {
+        seen += window->buckets[metric][b];
+        while (p < 3 && seen >= (uint64_t)(percentiles[p] * count + 0.999)) {
+            float value = b * (100.0f / ROLLUP_BUCKETS);
+            value = value < min ? min : value > max ? max : value;
+            *outputs[p++] = value * scale;
+        }
+    }
+}
+
+// Adds the samples of one tick to every window and refreshes the aggregates
+void rollupPush(Rollups *rollups, const MemSample *mem, const CpuSample *cpu) {
+    RollupPoint point;
+
+    if (!mem || !cpu || mem->physTotalGb <= 0)
+        return;
+
+    point.timestampNs = mem->header.timestampNs;
+    point.value[ROLLUP_CPU] = cpu->busy[0];
+    point.value[ROLLUP_MEM] = (float)(mem->physUsedGb / mem->physTotalGb * 100.0);
+
+    for (int w = 0; w < rollups->count; w++) {
+        RollupWindow *window = &rollups->windows[w];
+
+        while (window->next > window->first &&
+               (window->next - window->first == window->capacity ||
+                window->points[window->first % window->capacity].timestampNs + window->lengthNs <= point.timestampNs))
+            evictOldest(window);
+
+        uint64_t seq = window->next++;
+        window->points[seq % window->capacity] = point;
+
+        for (int m = 0; m < ROLLUP_METRICS; m++) {
+            window->sum[m] += point.value[m];
+            window->buckets[m][bucketOf(point.value[m])]++;
+            dequePush(window, &window->minDeque[m], seq, m, 0);
+            dequePush(window, &window->maxDeque[m], seq, m, 1);
+        }
+
+        windowStats(window, ROLLUP_CPU, 1.0f, &rollups->stats[w][ROLLUP_CPU]);
+        windowStats(window, ROLLUP_MEM, (float)(mem->physTotalGb / 100.0), &rollups->stats[w][ROLLUP_MEM]);
+    }
+}
+
+// Prints the aggregates of every window
+void printRollups(const Rollups *rollups) {
+    static const char *metricNames[ROLLUP_METRICS] = { "cpu %", "mem GB" };
+    char length[32];
+
+    renderf("### Rollups ###          min    mean     max     p50     p95     p99\n");
+    for (int w = 0; w < rollups->count; w++) {
+        uint64_t lengthNs = rollups->windows[w].lengthNs;
+
+        if (lengthNs % 60000000000ull == 0)
+            snprintf(length, sizeof(length), "%llum", (unsigned long long)(lengthNs / 60000000000ull));
+        else
+            snprintf(length, sizeof(length), "%gs", lengthNs / 1e9);
+
+        for (int m = 0; m < ROLLUP_METRICS; m++) {
+            const RollupStats *stats = &rollups->stats[w][m];
+            renderf(" %-6s %-9s %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f\n", m == 0 ? length : "", metricNames[m],
+                    stats->min, stats->mean, stats->max, stats->p50, stats->p95, stats->p99);
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include "stats_functions.h"
+
+#define ROLLUP_MAX_WINDOWS 4
+#define ROLLUP_BUCKETS 1000             // 0.1 percentage point per bucket
+#define ROLLUP_MAX_POINTS (1u << 20)    // cap on the samples one window holds
+#define ROLLUP_DEFAULT_WINDOWS "10s,1m,5m"
+
+enum { ROLLUP_CPU, ROLLUP_MEM, ROLLUP_METRICS };
+
+// Aggregates of one metric over one window (CPU in %, memory used in GB)
+typedef struct {
+    float min, mean, max;
+    float p50, p95, p99;
+} RollupStats;
+
+typedef struct {
+    uint64_t timestampNs;
+    float value[ROLLUP_METRICS];        // both metrics in % (memory: of physical total)
+} RollupPoint;
+
+// Monotonic deque of point sequence numbers: the front holds the window's min (or max)
+typedef struct {
+    uint64_t *items;
+    uint64_t front, back;
+} RollupDeque;
+
+// One time-based sliding window, updated in O(1) amortised per sample:
+// a FIFO of the points inside it, running sums, min/max deques and a
+// fixed-bucket histogram for the percentiles.
+typedef struct {
+    uint64_t lengthNs;
+    uint64_t capacity;
+    RollupPoint *points;
+    uint64_t first, next;               // sequence numbers of the oldest point and of the next one
+    double sum[ROLLUP_METRICS];
+    RollupDeque minDeque[ROLLUP_METRICS], maxDeque[ROLLUP_METRICS];
+    uint32_t buckets[ROLLUP_METRICS][ROLLUP_BUCKETS];
+} RollupWindow;
+
+typedef struct {
+    int count;
+    RollupWindow windows[ROLLUP_MAX_WINDOWS];
+    RollupStats stats[ROLLUP_MAX_WINDOWS][ROLLUP_METRICS];   // refreshed by every rollupPush
+} Rollups;
+
+// Function prototypes
+int parseWindows(const char *text, uint64_t *windowsNs);
+int rollupInit(Rollups *rollups, const uint64_t *windowsNs, int count, uint64_t intervalNs);
+void rollupPush(Rollups *rollups, const MemSample *mem, const CpuSample *cpu);
+void rollupFree(Rollups *rollups);
+void printRollups(const Rollups *rollups);
+
+#endif // ROLLUP_H
@@ -0,0 +1,128 @@
+#define _GNU_SOURCE
+
+#include "sample_ring.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// Sleeps while *word still equals expected (shared futex, works across fork)
+void futexWait(uint32_t *word, uint32_t expected) {
+    syscall(SYS_futex, word, FUTEX_WAIT, expected, NULL, NULL, 0);
+}
+
+// Wakes every process sleeping on word
+void futexWake(uint32_t *word) {
+    syscall(SYS_futex, word, FUTEX_WAKE, 0x7fffffff, NULL, NULL, 0);
+}
+
+// Maps a shared ring with capacity slots of slotSize bytes (capacity rounded up to a power of two)
+SampleRing *ringCreate(uint32_t capacity, size_t slotSize) {
+    uint32_t cap = 1;
+    while (cap < capacity)
+        cap <<= 1;
+
+    size_t bytes = sizeof(SampleRing) + (size_t)cap * slotSize;
+    SampleRing *ring = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED)
+        return NULL;
+
+    memset(ring, 0, sizeof(SampleRing));
+    ring->capacity = cap;
+    ring->slotSize = (uint32_t)slotSize;
+    return ring;
+}
+
+// Unmaps the ring in the calling process
+void ringDestroy(SampleRing *ring) {
+    if (ring)
+        munmap(ring, sizeof(SampleRing) + (size_t)ring->capacity * ring->slotSize);
+}
+
+// Copies one sample into the ring, waiting while the ring is full
+int ringPush(SampleRing *ring, const void *sample) {
+    uint32_t head = ring->head;
+
+    for (;;) {
+        uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head - tail < ring->capacity)
+            break;
+
+        __atomic_store_n(&ring->tailWaiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == tail)
+            futexWait(&ring->tail, tail);
+        __atomic_store_n(&ring->tailWaiting, 0, __ATOMIC_RELAXED);
+    }
+
+    memcpy(ring->slots + (size_t)(head & (ring->capacity - 1)) * ring->slotSize,
+           sample, ring->slotSize);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&ring->headSeq, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&ring->headWaiting, __ATOMIC_SEQ_CST))
+        futexWake(&ring->headSeq);
+    return 0;
+}
+
+// Copies sample into the next slot if one is free; returns 1 if it was pushed, 0 if the ring is full
+int ringTryPush(SampleRing *ring, const void *sample) {
+    uint32_t head = ring->head;
+
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= ring->capacity)
+        return 0;
+
+    memcpy(ring->slots + (size_t)(head & (ring->capacity - 1)) * ring->slotSize,
+           sample, ring->slotSize);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&ring->headSeq, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&ring->headWaiting, __ATOMIC_SEQ_CST))
+        futexWake(&ring->headSeq);
+    return 1;
+}
+
+// Copies the oldest sample out of the ring if one is ready; returns 1 if a sample was read
+int ringTryPop(SampleRing *ring, void *sample) {
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    if (head == tail)
+        return 0;
+
+    memcpy(sample, ring->slots + (size_t)(tail & (ring->capacity - 1)) * ring->slotSize,
+           ring->slotSize);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&ring->tailWaiting, __ATOMIC_SEQ_CST))
+        futexWake(&ring->tail);
+    return 1;
+}
+
+// Waits for the next sample; returns -1 once the ring is empty and closed
+int ringPop(SampleRing *ring, void *sample) {
+    for (;;) {
+        if (ringTryPop(ring, sample))
+            return 0;
+
+        __atomic_store_n(&ring->headWaiting, 1, __ATOMIC_SEQ_CST);
+        uint32_t seq = __atomic_load_n(&ring->headSeq, __ATOMIC_SEQ_CST);
+
+        if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == ring->tail) {
+            if (__atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST)) {
+                __atomic_store_n(&ring->headWaiting, 0, __ATOMIC_RELAXED);
+                return -1;
+            }
+            futexWait(&ring->headSeq, seq);
+        }
+        __atomic_store_n(&ring->headWaiting, 0, __ATOMIC_RELAXED);
+    }
+}
+
+// Marks the ring as finished and wakes a waiting consumer
+void ringClose(SampleRing *ring) {
+    __atomic_store_n(&ring->closed, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&ring->headSeq, 1, __ATOMIC_SEQ_CST);
+    futexWake(&ring->headSeq);
+}
@@ -0,0 +1,38 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Single-producer/single-consumer ring of fixed-size binary samples.
+// The ring lives in an anonymous shared mapping, so a ring created before
+// fork() is visible to both the collector child and the parent.
+typedef struct {
+    uint32_t head;          // next slot the producer fills
+    uint32_t headSeq;       // bumped on every push and on close (futex word)
+    uint32_t headWaiting;   // consumer is sleeping on headSeq
+    char pad0[52];
+    uint32_t tail;          // next slot the consumer drains (futex word)
+    uint32_t tailWaiting;   // producer is sleeping on tail
+    char pad1[56];
+    uint32_t closed;        // producer will not push anymore
+    uint32_t capacity;      // number of slots, power of two
+    uint32_t slotSize;      // bytes per slot
+    char pad2[52];
+    unsigned char slots[];
+} SampleRing;
+
+// Function prototypes
+SampleRing *ringCreate(uint32_t capacity, size_t slotSize);
+void ringDestroy(SampleRing *ring);
+
+int ringPush(SampleRing *ring, const void *sample);
+int ringTryPush(SampleRing *ring, const void *sample);
+int ringPop(SampleRing *ring, void *sample);
+int ringTryPop(SampleRing *ring, void *sample);
+void ringClose(SampleRing *ring);
+
+void futexWait(uint32_t *word, uint32_t expected);
+void futexWake(uint32_t *word);
+
+#endif // SAMPLE_RING_H
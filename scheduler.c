@@ -0,0 +1,151 @@
+#define _GNU_SOURCE
+
+#include "scheduler.h"
+#include "sample_ring.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+
+// Maps a clock shared with the children forked after this call
+SampleClock *clockCreate(uint64_t intervalNs) {
+    SampleClock *clock = mmap(NULL, sizeof(SampleClock), PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (clock == MAP_FAILED)
+        return NULL;
+
+    memset(clock, 0, sizeof(SampleClock));
+    clock->tick = CLOCK_NOT_STARTED;
+    clock->intervalNs = intervalNs;
+    return clock;
+}
+
+// Unmaps the clock in the calling process
+void clockDestroy(SampleClock *clock) {
+    if (clock)
+        munmap(clock, sizeof(SampleClock));
+}
+
+// Returns the current CLOCK_MONOTONIC time in nanoseconds
+uint64_t monotonicNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+// Absolute deadline of a tick at or after the current base
+uint64_t clockDeadline(const SampleClock *clock, uint32_t tick) {
+    return clock->baseNs + (uint64_t)(tick - clock->baseTick) * clock->intervalNs;
+}
+
+// Spaces the ticks after tick by intervalNs, keeping tick's own deadline as the anchor
+void clockSetInterval(SampleClock *clock, uint32_t tick, uint64_t intervalNs) {
+    if (intervalNs == clock->intervalNs)
+        return;
+    clock->baseNs = clockDeadline(clock, tick);
+    clock->baseTick = tick;
+    clock->intervalNs = intervalNs;
+}
+
+// Sleeps until an absolute CLOCK_MONOTONIC deadline, resuming after signals
+void clockSleepUntil(uint64_t deadlineNs) {
+    struct timespec when;
+    when.tv_sec = deadlineNs / 1000000000ull;
+    when.tv_nsec = deadlineNs % 1000000000ull;
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, NULL) == EINTR)
+        ;
+}
+
+// Anchors tick 0 at the current time and publishes it
+void clockStart(SampleClock *clock) {
+    clock->baseNs = monotonicNs();
+    clock->baseTick = 0;
+    clockPublish(clock, 0);
+}
+
+// Publishes a tick and wakes every collector waiting for it
+void clockPublish(SampleClock *clock, uint32_t tick) {
+    __atomic_store_n(&clock->tick, tick, __ATOMIC_SEQ_CST);
+    futexWake(&clock->tick);
+}
+
+// Waits for a tick newer than *lastTick; returns -1 once the clock is stopped
+int clockWaitTick(SampleClock *clock, uint32_t *lastTick) {
+    for (;;) {
+        uint32_t tick = __atomic_load_n(&clock->tick, __ATOMIC_SEQ_CST);
+
+        if (__atomic_load_n(&clock->stopped, __ATOMIC_SEQ_CST))
+            return -1;
+        if (tick != *lastTick) {
+            *lastTick = tick;
+            return 0;
+        }
+        futexWait(&clock->tick, tick);
+    }
+}
+
+// Stops the clock; waiting collectors return from clockWaitTick with -1
+void clockStop(SampleClock *clock) {
+    __atomic_store_n(&clock->stopped, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&clock->tick, 1, __ATOMIC_SEQ_CST);
+    futexWake(&clock->tick);
+}
+
+// Returns a timerfd firing at every tick deadline after tick 0, or -1 on error
+int clockTimerFd(const SampleClock *clock) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (fd == -1)
+        return -1;
+
+    if (clockRearmTimerFd(clock, fd, 0) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Re-arms fd for the deadlines after tick at the clock's current interval
+int clockRearmTimerFd(const SampleClock *clock, int fd, uint32_t tick) {
+    uint64_t next = clockDeadline(clock, tick + 1);
+    struct itimerspec spec;
+
+    spec.it_value.tv_sec = next / 1000000000ull;
+    spec.it_value.tv_nsec = next % 1000000000ull;
+    spec.it_interval.tv_sec = clock->intervalNs / 1000000000ull;
+    spec.it_interval.tv_nsec = clock->intervalNs % 1000000000ull;
+    return timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+// Parses "2", "0.25", "2s", "250ms", "5m" or "1h" into nanoseconds; returns -1 if invalid
+int parseInterval(const char *text, uint64_t *intervalNs) {
+    char *end;
+    double value = strtod(text, &end);
+
+    if (end == text || value <= 0)
+        return -1;
+
+    if (strcmp(end, "ms") == 0)
+        value /= 1000.0;
+    else if (strcmp(end, "m") == 0)
+        value *= 60.0;
+    else if (strcmp(end, "h") == 0)
+        value *= 3600.0;
+    else if (*end != '\0' && strcmp(end, "s") != 0)
+        return -1;
+
+    *intervalNs = (uint64_t)(value * 1e9 + 0.5);
+    return *intervalNs >= 1000000ull ? 0 : -1;
+}
+
+// Formats an interval as "N secs" or "N ms" for the header line
+void formatInterval(uint64_t intervalNs, char *out, int size) {
+    if (intervalNs % 1000000000ull == 0)
+        snprintf(out, size, "%llu secs", (unsigned long long)(intervalNs / 1000000000ull));
+    else
+        snprintf(out, size, "%g ms", intervalNs / 1e6);
+}
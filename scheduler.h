@@ -0,0 +1,49 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+// Sample clock shared by the parent and the collector children.
+// The parent sleeps to absolute deadlines (base + (tick - baseTick) * interval)
+// and publishes each tick; collectors wake on the published tick, so every
+// collector samples in phase and the schedule never drifts. Changing the
+// interval re-anchors the base at the current tick's deadline.
+typedef struct {
+    uint32_t tick;          // last published tick (futex word)
+    uint32_t stopped;       // no more ticks will be published
+    uint32_t baseTick;      // tick the current interval started at
+    uint64_t baseNs;        // CLOCK_MONOTONIC deadline of baseTick (tick 0: the start)
+    uint64_t intervalNs;    // time between two ticks
+} SampleClock;
+
+#define CLOCK_NOT_STARTED UINT32_MAX
+
+// Every binary sample starts with this header
+typedef struct {
+    uint64_t timestampNs;   // CLOCK_MONOTONIC time the sample was taken
+    uint64_t readyNs;       // time the collector pushed it (see latencyStamp)
+    uint64_t cpuNs;         // CPU time the collector has used so far
+    uint32_t tick;          // clock tick the sample belongs to
+    uint32_t collectNs;     // time the collector spent producing it
+} SampleHeader;
+
+// Function prototypes
+SampleClock *clockCreate(uint64_t intervalNs);
+void clockDestroy(SampleClock *clock);
+
+uint64_t monotonicNs(void);
+uint64_t clockDeadline(const SampleClock *clock, uint32_t tick);
+void clockSetInterval(SampleClock *clock, uint32_t tick, uint64_t intervalNs);
+void clockSleepUntil(uint64_t deadlineNs);
+
+void clockStart(SampleClock *clock);
+void clockPublish(SampleClock *clock, uint32_t tick);
+int clockWaitTick(SampleClock *clock, uint32_t *lastTick);
+void clockStop(SampleClock *clock);
+int clockTimerFd(const SampleClock *clock);
+int clockRearmTimerFd(const SampleClock *clock, int fd, uint32_t tick);
+
+int parseInterval(const char *text, uint64_t *intervalNs);
+void formatInterval(uint64_t intervalNs, char *out, int size);
+
+#endif // SCHEDULER_H
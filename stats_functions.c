@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include "stats_functions.h"
 #include <signal.h>
 #include <stdio.h>
@@ -11,81 +13,258 @@
 #include <math.h>
 #include <fcntl.h>
 #include <paths.h>
+#include <poll.h>
+#include <sys/inotify.h>
 
 // Prints the top line with memory usage and sample metadata
-void GetInfoTop(int samples, int tdelay, int sequential, int i) {
+void GetInfoTop(int samples, uint64_t intervalNs, int sequential, int i) {
     struct rusage usage_info;
     int result = getrusage(RUSAGE_SELF, &usage_info);
+    char every[32];
+
+    formatInterval(intervalNs, every, sizeof(every));
 
     if (sequential)
-        printf(">>> iteration %d\n", i);
+        renderf(">>> iteration %d\n", i);
     else {
-        printf("\033[H\033[2J");
-        printf("Nbr of samples: %d -- every %d secs\n", samples, tdelay);
+        if (samples > 0)
+            renderf("Nbr of samples: %d -- every %s\n", samples, every);
+        else
+            renderf("Nbr of samples: unlimited -- every %s\n", every);
     }
 
     if (result == 0)
-        printf("Memory usage: %ld kilobytes\n", usage_info.ru_maxrss);
+        renderf("Memory usage: %ld kilobytes\n", usage_info.ru_maxrss);
     else
         perror("Failed to get resource usage");
 }
 
-// Stores memory statistics into a pipe
-void storeMemArr(int samples, int memFD[2], int tdelay) {
-    char memArr[samples][1024];
-    struct sysinfo sys_info;
+// /proc/meminfo keys the memory collector reads, in the order the kernel prints them
+enum {
+    MI_MEM_TOTAL, MI_MEM_FREE, MI_MEM_AVAILABLE, MI_BUFFERS, MI_CACHED, MI_SWAP_CACHED,
+    MI_SWAP_TOTAL, MI_SWAP_FREE, MI_DIRTY, MI_WRITEBACK, MI_ANON_PAGES, MI_SLAB,
+    MI_HUGE_TOTAL, MI_HUGE_FREE, MI_HUGE_SIZE, MI_KEYS
+};
+
+#define MI_KEY(name) { name, sizeof(name) - 1 }
+
+static const struct {
+    const char *name;
+    size_t len;
+} meminfoKeys[MI_KEYS] = {
+    MI_KEY("MemTotal"), MI_KEY("MemFree"), MI_KEY("MemAvailable"), MI_KEY("Buffers"), MI_KEY("Cached"),
+    MI_KEY("SwapCached"), MI_KEY("SwapTotal"), MI_KEY("SwapFree"), MI_KEY("Dirty"), MI_KEY("Writeback"),
+    MI_KEY("AnonPages"), MI_KEY("Slab"), MI_KEY("HugePages_Total"), MI_KEY("HugePages_Free"),
+    MI_KEY("Hugepagesize"),
+};
+
+// Key of a "Key:   value kB" line, or -1; tries the key after the previous match first
+static int meminfoKey(const char *p, size_t len, int expected) {
+    if (expected < MI_KEYS && meminfoKeys[expected].len == len && memcmp(p, meminfoKeys[expected].name, len) == 0)
+        return expected;
+    for (int k = 0; k < MI_KEYS; k++)
+        if (meminfoKeys[k].len == len && memcmp(p, meminfoKeys[k].name, len) == 0)
+            return k;
+    return -1;
+}
 
-    for (int i = 0; i < samples; i++) {
-        sysinfo(&sys_info);
-        double phys_total_gb = sys_info.totalram / (1024.0 * 1024 * 1024);
-        double phys_free_gb = sys_info.freeram / (1024.0 * 1024 * 1024);
-        double phys_used_gb = phys_total_gb - phys_free_gb;
+// Parses the wanted keys of /proc/meminfo into values (kB, or pages for HugePages_*); returns a bitmask of keys found
+static unsigned parseMeminfo(const char *p, uint64_t values[MI_KEYS]) {
+    unsigned found = 0;
+    int next = 0;
+
+    while (*p) {
+        const char *colon = p;
+        while (*colon && *colon != ':' && *colon != '\n')
+            colon++;
+
+        if (*colon == ':') {
+            int k = meminfoKey(p, colon - p, next);
+            if (k != -1 && procScanU64(colon + 1, &values[k])) {
+                found |= 1u << k;
+                next = k + 1;
+            }
+        }
+        p = procSkipLine(colon);
+    }
+    return found;
+}
 
-        double swap_total_gb = sys_info.totalswap / (1024.0 * 1024 * 1024);
-        double swap_free_gb = sys_info.freeswap / (1024.0 * 1024 * 1024);
+// Opens /proc/meminfo for the lifetime of the collector
+int memInit(MemCollector *mem) {
+    return procOpen(&mem->meminfo, "/proc/meminfo", mem->buf, sizeof(mem->buf));
+}
 
-        double virtual_used_gb = phys_used_gb + (swap_total_gb - swap_free_gb);
-        double virtual_total_gb = phys_total_gb + swap_total_gb;
+// Reads the current memory figures from /proc/meminfo into a binary sample
+void sampleMem(MemCollector *mem, MemSample *sample) {
+    uint64_t kb[MI_KEYS] = {0};
+    const double kbToGb = 1.0 / (1024.0 * 1024);
 
-        snprintf(memArr[i], sizeof(memArr[i]),
-                 "%.2f GB / %.2f GB  -- %.2f GB / %.2f GB",
-                 phys_used_gb, phys_total_gb,
-                 virtual_used_gb, virtual_total_gb);
+    if (procRead(&mem->meminfo) == -1) {
+        perror("Failed to read /proc/meminfo");
+        exit(EXIT_FAILURE);
+    }
 
-        if (write(memFD[1], memArr[i], sizeof(memArr[i])) == -1) {
-            perror("Error writing memory data to pipe");
-            kill(getpid(), SIGTERM);
-            kill(getppid(), SIGTERM);
-        }
+    unsigned found = parseMeminfo(mem->meminfo.buf, kb);
+
+    // Kernels before 3.14 have no MemAvailable; free + buffers + cache is the usual estimate
+    if (!(found & (1u << MI_MEM_AVAILABLE)))
+        kb[MI_MEM_AVAILABLE] = kb[MI_MEM_FREE] + kb[MI_BUFFERS] + kb[MI_CACHED];
+
+    double swapUsedGb = (kb[MI_SWAP_TOTAL] - kb[MI_SWAP_FREE]) * kbToGb;
+
+    sample->physTotalGb = kb[MI_MEM_TOTAL] * kbToGb;
+    sample->physUsedGb = (kb[MI_MEM_TOTAL] - kb[MI_MEM_AVAILABLE]) * kbToGb;
+    sample->virtUsedGb = sample->physUsedGb + swapUsedGb;
+    sample->virtTotalGb = sample->physTotalGb + kb[MI_SWAP_TOTAL] * kbToGb;
+
+    sample->detailed = 1;
+    sample->availGb = kb[MI_MEM_AVAILABLE] * kbToGb;
+    sample->buffersGb = kb[MI_BUFFERS] * kbToGb;
+    sample->cachedGb = kb[MI_CACHED] * kbToGb;
+    sample->dirtyGb = kb[MI_DIRTY] * kbToGb;
+    sample->writebackGb = kb[MI_WRITEBACK] * kbToGb;
+    sample->slabGb = kb[MI_SLAB] * kbToGb;
+    sample->anonGb = kb[MI_ANON_PAGES] * kbToGb;
+    sample->swapCachedGb = kb[MI_SWAP_CACHED] * kbToGb;
+    sample->hugeTotalGb = kb[MI_HUGE_TOTAL] * kb[MI_HUGE_SIZE] * kbToGb;
+    sample->hugeFreeGb = kb[MI_HUGE_FREE] * kb[MI_HUGE_SIZE] * kbToGb;
+}
+
+void memFree(MemCollector *mem) {
+    procClose(&mem->meminfo);
+}
+
+// Prints where the memory of the latest sample goes
+void printMemBreakdown(const MemSample *sample) {
+    if (!sample->detailed)
+        return;
+
+    renderf("Avail %.2f GB | Anon %.2f | Cached %.2f | Buffers %.2f | Slab %.2f | Dirty %.2f | Writeback %.2f GB\n",
+            sample->availGb, sample->anonGb, sample->cachedGb, sample->buffersGb, sample->slabGb,
+            sample->dirtyGb, sample->writebackGb);
+    if (sample->hugeTotalGb > 0 || sample->swapCachedGb > 0)
+        renderf("HugePages %.2f / %.2f GB free | SwapCached %.2f GB\n",
+                sample->hugeFreeGb, sample->hugeTotalGb, sample->swapCachedGb);
+}
+
+// Pushes one memory sample per clock tick (after tick 0) into the shared ring
+void storeMemArr(SampleClock *clock, SampleRing *memRing) {
+    collectorRun("mem", clock, memRing);
+}
+
+static int memCollectorInit(void *state) {
+    return memInit(state);
+}
+
+static int memCollectorSample(void *state, void *out) {
+    MemSample *sample = out;
+
+    sampleMem(state, sample);
+    sample->header.timestampNs = monotonicNs();
+    return 0;
+}
+
+static void memCollectorTeardown(void *state) {
+    memFree(state);
+}
+
+const CollectorOps memCollector = {
+    .name = "mem", .stateSize = sizeof(MemCollector), .sampleSize = sizeof(MemSample),
+    .latencyPhase = LAT_COLLECT_MEM, .init = memCollectorInit, .sample = memCollectorSample,
+    .teardown = memCollectorTeardown,
+};
+
+// Sizes the history for a run; unlimited runs (samples == 0) keep HISTORY_WINDOW rows
+void historyInit(History *history, int samples) {
+    memset(history, 0, sizeof(History));
+    history->window = (samples > 0 && samples < HISTORY_WINDOW) ? samples : HISTORY_WINDOW;
+}
 
-        sleep(tdelay);
+// Records one iteration, overwriting the oldest once the window is full
+void historyPush(History *history, const MemSample *mem, const CpuSample *cpu, double graphVirtGb) {
+    HistorySample *entry = &history->items[history->count % history->window];
+
+    memset(entry, 0, sizeof(HistorySample));
+    entry->iteration = history->count;
+
+    if (mem) {
+        entry->timestampNs = mem->header.timestampNs;
+        entry->hasMem = 1;
+        entry->physUsedGb = mem->physUsedGb;
+        entry->physTotalGb = mem->physTotalGb;
+        entry->virtUsedGb = mem->virtUsedGb;
+        entry->virtTotalGb = mem->virtTotalGb;
+        entry->graphVirtGb = graphVirtGb;
+        entry->graphDiffGb = graphVirtGb - history->prevVirtGb;
+        history->prevVirtGb = graphVirtGb;
     }
+
+    if (cpu) {
+        if (!mem)
+            entry->timestampNs = cpu->header.timestampNs;
+        entry->hasCpu = 1;
+        entry->cpuBusy = cpu->busy[0];
+        entry->cpuDelta = history->count == 0 ? cpu->busy[0] : cpu->busy[0] - history->prevCpuBusy;
+        history->prevCpuBusy = cpu->busy[0];
+    }
+
+    history->count++;
+}
+
+// Returns the entry of an iteration, or NULL if it has left the window
+const HistorySample *historyAt(const History *history, unsigned long iteration) {
+    if (iteration >= history->count || history->count - iteration > (unsigned long)history->window)
+        return NULL;
+    return &history->items[iteration % history->window];
 }
 
-// Displays memory information from memArr
-void fcnForPrintMemoryArr(int sequential, int samples, char memArr[][1024], int i, int memFD[2]) {
-    printf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot)\n");
+// Formats one history entry as a memory line (parent side, at render time)
+void formatMemArr(const HistorySample *entry, int graphics, char *line, size_t size) {
+    if (!entry->hasMem) {
+        line[0] = '\0';
+        return;
+    }
+
+    snprintf(line, size,
+             "%.2f GB / %.2f GB  -- %.2f GB / %.2f GB",
+             entry->physUsedGb, entry->physTotalGb,
+             entry->virtUsedGb, entry->virtTotalGb);
+
+    if (graphics)
+        memoryGraphics(entry->graphVirtGb, entry->graphDiffGb, entry->iteration == 0, line, size);
+}
+
+// Displays the memory lines of the visible window
+void fcnForPrintMemoryArr(int sequential, const History *history, int graphics) {
+    char line[1024];
+    unsigned long current = history->count - 1;
+
+    renderf("### Memory ### (Phys.Used/Tot -- Virtual Used/Tot)\n");
 
     if (sequential) {
-        for (int k = 0; k < samples; k++) {
-            if (k == i)
-                printf("%s\n", memArr[k]);
-            else
-                printf("\n");
+        for (int k = 0; k < history->window; k++) {
+            if ((unsigned long)k == current % history->window) {
+                formatMemArr(historyAt(history, current), graphics, line, sizeof(line));
+                renderf("%s\n", line);
+            } else
+                renderf("\n");
         }
     } else {
-        for (int j = 0; j <= i; j++)
-            printf("%s\n", memArr[j]);
+        unsigned long first = history->count > (unsigned long)history->window ? history->count - history->window : 0;
+        for (unsigned long j = first; j <= current; j++) {
+            formatMemArr(historyAt(history, j), graphics, line, sizeof(line));
+            renderf("%s\n", line);
+        }
     }
 }
 
-// Adds a graphical representation to the memory line
-void memoryGraphics(double virtual_used_gb, double *prev_used_gb, char memArr[][1024], int i) {
-    double difference = virtual_used_gb - *prev_used_gb;
+// Appends a graphical representation of the memory change to line
+void memoryGraphics(double virtual_used_gb, double difference, int first, char *line, size_t size) {
     char graphicsStr[1024] = "|";
     char infoStr[100];
 
-    if (i == 0 || fabs(difference) < 0.01) {
+    if (first || fabs(difference) < GRAPHICS_FLAT_GB) {
         snprintf(graphicsStr + 1, sizeof(graphicsStr) - 1,
                  "%s %.2f (%.2f)", difference >= 0 ? "o" : "@", difference, virtual_used_gb);
     } else {
@@ -99,151 +278,455 @@ void memoryGraphics(double virtual_used_gb, double *prev_used_gb, char memArr[][
         strcat(graphicsStr, infoStr);
     }
 
-    strcat(memArr[i], " ");
-    strcat(memArr[i], graphicsStr);
-    memArr[i][1023] = '\0';
+    size_t len = strlen(line);
+    snprintf(line + len, size - len, " %s", graphicsStr);
+}
+
+// Parses "FAST[,CPU[,MEM]]" (e.g. "50ms,5,0.01"): the fast interval, the CPU busy change in
+// percentage points and the virtual memory change in GB that count as movement; NULL keeps the defaults
+int parseAdaptive(const char *text, AdaptiveRate *rate) {
+    char item[32];
+
+    rate->fastNs = ADAPTIVE_FAST_NS;
+    rate->cpuPoints = ADAPTIVE_CPU_POINTS;
+    rate->memGb = GRAPHICS_FLAT_GB;
+
+    for (int field = 0; text && *text; field++) {
+        size_t len = strcspn(text, ",");
+        char *end;
+        if (len == 0 || len >= sizeof(item) || field > 2)
+            return -1;
+        memcpy(item, text, len);
+        item[len] = '\0';
+
+        if (field == 0 && parseInterval(item, &rate->fastNs) == -1)
+            return -1;
+        if (field > 0) {
+            double value = strtod(item, &end);
+            if (*end || value < 0)
+                return -1;
+            *(field == 1 ? &rate->cpuPoints : &rate->memGb) = value;
+        }
+
+        text += len;
+        if (*text == ',')
+            text++;
+    }
+    return 0;
+}
+
+// Starts at the slow interval; parseAdaptive has set the fast one and the thresholds
+void adaptiveInit(AdaptiveRate *rate, uint64_t slowNs) {
+    rate->slowNs = slowNs;
+    if (rate->fastNs > slowNs)
+        rate->fastNs = slowNs;
+    rate->intervalNs = slowNs;
+    rate->prevVirtGb = rate->prevCpuBusy = NAN;   // nothing to compare the first sample with
+    rate->bursts = 0;
+}
+
+// Picks the interval until the next tick from the change since the previous sample:
+// the same virtual memory difference memoryGraphics draws, and the CPU busy change
+uint64_t adaptiveUpdate(AdaptiveRate *rate, const MemSample *mem, const CpuSample *cpu) {
+    int moved = 0;
 
-    *prev_used_gb = virtual_used_gb;
+    if (mem) {
+        moved |= fabs(mem->virtUsedGb - rate->prevVirtGb) >= rate->memGb;
+        rate->prevVirtGb = mem->virtUsedGb;
+    }
+    if (cpu && cpu->rows > 0) {
+        moved |= fabs(cpu->busy[0] - rate->prevCpuBusy) >= rate->cpuPoints;
+        rate->prevCpuBusy = cpu->busy[0];
+    }
+
+    if (moved) {
+        if (rate->intervalNs != rate->fastNs)
+            rate->bursts++;
+        rate->intervalNs = rate->fastNs;
+    } else if (rate->intervalNs < rate->slowNs) {
+        rate->intervalNs = rate->intervalNs * 2 < rate->slowNs ? rate->intervalNs * 2 : rate->slowNs;
+    }
+    return rate->intervalNs;
 }
 
-// Writes user session info to pipe
-void storeUserInfoThird(int userFD[2], int ucountFD[2]) {
+// Reads the current user sessions from utmp into table; returns -1 (table left as is) if
+// utmp cannot be selected, so the engine running the scan can stop
+int sampleUsers(SessionTable *table) {
     struct utmp *utmp;
     if (utmpname(_PATH_UTMP) == -1) {
         perror("Failed to set utmp file path");
-        kill(getpid(), SIGTERM);
-        kill(getppid(), SIGTERM);
+        return -1;
     }
 
     setutent();
-    int userLine_count = 0;
+    table->count = 0;
 
-    while ((utmp = getutent()) != NULL) {
+    while ((utmp = getutent()) != NULL && table->count < MAX_SESSIONS) {
         if (utmp->ut_type == USER_PROCESS) {
-            char buffer[1024];
-            snprintf(buffer, sizeof(buffer), "%s\t %s (%s)\n", utmp->ut_user, utmp->ut_line, utmp->ut_host);
+            SessionSample *session = &table->sessions[table->count++];
+            snprintf(session->user, sizeof(session->user), "%.*s", (int)sizeof(utmp->ut_user), utmp->ut_user);
+            snprintf(session->line, sizeof(session->line), "%.*s", (int)sizeof(utmp->ut_line), utmp->ut_line);
+            snprintf(session->host, sizeof(session->host), "%.*s", (int)sizeof(utmp->ut_host), utmp->ut_host);
+        }
+    }
 
-            if (write(userFD[1], buffer, strlen(buffer)) == -1) {
-                perror("Error writing user info to pipe");
-                kill(getpid(), SIGTERM);
-                kill(getppid(), SIGTERM);
-            }
+    endutent();
+    return 0;
+}
+
+// Watches the directory holding utmp, so the file is noticed even when it is created or replaced; -1 on failure
+int sessionWatchOpen(void) {
+    char dir[64];
+    const char *slash = strrchr(_PATH_UTMP, '/');
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (fd == -1 || !slash)
+        return -1;
+    snprintf(dir, sizeof(dir), "%.*s", (int)(slash - _PATH_UTMP), _PATH_UTMP);
 
-            userLine_count++;
+    if (inotify_add_watch(fd, dir, IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO | IN_DELETE) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Drains pending inotify events; returns 1 if any of them concerned utmp
+int sessionWatchChanged(int watchFd) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const char *name = strrchr(_PATH_UTMP, '/') + 1;
+    ssize_t n;
+    int changed = 0;
+
+    while ((n = read(watchFd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n; ) {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            if (event->len > 0 && strcmp(event->name, name) == 0)
+                changed = 1;
+            p += sizeof(struct inotify_event) + event->len;
         }
     }
+    return changed;
+}
 
-    if (write(ucountFD[1], &userLine_count, sizeof(userLine_count)) == -1) {
-        perror("Error writing user count to pipe");
-        kill(getpid(), SIGTERM);
-        kill(getppid(), SIGTERM);
+// Index of a session in table, or -1
+static int findSession(const SessionTable *table, const SessionSample *session) {
+    for (int i = 0; i < table->count; i++) {
+        const SessionSample *s = &table->sessions[i];
+        if (strcmp(s->line, session->line) == 0 && strcmp(s->user, session->user) == 0 &&
+            strcmp(s->host, session->host) == 0)
+            return i;
     }
+    return -1;
+}
 
-    endutent();
+// Pushes one event per session that differs between two utmp scans. The push
+// never blocks (the parent may not drain for a while); returns -1 if the ring
+// filled up and events were dropped
+static int pushSessionChanges(const SessionTable *old, SessionTable *now, SampleRing *userRing) {
+    for (int i = 0; i < old->count; i++) {
+        if (findSession(now, &old->sessions[i]) == -1) {
+            SessionSample event = old->sessions[i];
+            event.event = SESSION_REMOVE;
+            if (!ringTryPush(userRing, &event))
+                return -1;
+        }
+    }
+    for (int i = 0; i < now->count; i++) {
+        now->sessions[i].event = SESSION_ADD;
+        if (findSession(old, &now->sessions[i]) == -1 && !ringTryPush(userRing, &now->sessions[i]))
+            return -1;
+    }
+    return 0;
 }
 
-// Reads and prints user info from pipe
-void printUserInfoThird(int userFD[2]) {
-    char buffer[1024] = "";
-    ssize_t bytesRead = read(userFD[0], buffer, sizeof(buffer) - 1);
+// Replaces the parent's table with a full snapshot after events were dropped; returns -1 if it did not fit yet
+static int pushSessionResync(SessionTable *now, SampleRing *userRing) {
+    SessionSample reset = { .event = SESSION_RESET };
+
+    if (!ringTryPush(userRing, &reset))
+        return -1;
+    for (int i = 0; i < now->count; i++) {
+        now->sessions[i].event = SESSION_ADD;
+        if (!ringTryPush(userRing, &now->sessions[i]))
+            return -1;
+    }
+    return 0;
+}
 
-    printf("### Sessions/users ###\n");
+// Pushes the current sessions, then re-reads utmp only when inotify reports a change
+// and pushes the sessions that came or went, until the clock stops. When the ring
+// overflows the events are dropped and a full snapshot is pushed once there is room.
+// This runs in a collector child, so a utmp failure stops the monitor (its parent).
+void storeUserInfoThird(SampleClock *clock, SampleRing *userRing) {
+    static SessionTable tables[2];
+    int curr = 0;
+    int watchFd = sessionWatchOpen();
+    int failed = sampleUsers(&tables[curr]) == -1;
+    int resync = !failed && pushSessionChanges(&tables[curr ^ 1], &tables[curr], userRing) == -1;
+
+    // Wake at most once per tick (and at least every 100 ms) to notice the clock stopping
+    int timeoutMs = clock->intervalNs / 1000000 > 100 ? (int)(clock->intervalNs / 1000000) : 100;
+
+    while (!failed && !__atomic_load_n(&clock->stopped, __ATOMIC_SEQ_CST)) {
+        struct pollfd fds = { .fd = watchFd, .events = POLLIN };
+        int changed;
+
+        if (watchFd == -1)
+            changed = poll(NULL, 0, timeoutMs) < 0;
+        else
+            changed = poll(&fds, 1, timeoutMs) > 0 && sessionWatchChanged(watchFd);
+        if (!changed && !resync)
+            continue;
+
+        if (sampleUsers(&tables[curr ^ 1]) == -1) {
+            failed = 1;
+            break;
+        }
+        curr ^= 1;
+        if (resync)
+            resync = pushSessionResync(&tables[curr], userRing) == -1;
+        else
+            resync = pushSessionChanges(&tables[curr ^ 1], &tables[curr], userRing) == -1;
+    }
 
-    if (bytesRead > 0) {
-        buffer[bytesRead] = '\0';
-        printf("%s", buffer);
-    } else if (bytesRead == -1) {
-        perror("Error reading from user pipe");
-        kill(getpid(), SIGTERM);
+    if (watchFd != -1)
+        close(watchFd);
+    ringClose(userRing);
+    if (failed)
         kill(getppid(), SIGTERM);
+}
+
+// Applies the session events pushed by the user collector (if any) to table
+void drainSessions(SampleRing *userRing, SessionTable *table) {
+    SessionSample session;
+
+    while (userRing && ringTryPop(userRing, &session)) {
+        int i = findSession(table, &session);
+
+        if (session.event == SESSION_RESET)
+            table->count = 0;
+        else if (session.event == SESSION_REMOVE && i != -1) {
+            table->count--;
+            memmove(&table->sessions[i], &table->sessions[i + 1], (table->count - i) * sizeof(SessionSample));
+        } else if (session.event == SESSION_ADD && i == -1 && table->count < MAX_SESSIONS)
+            table->sessions[table->count++] = session;
     }
 }
 
-// Prints number of CPU cores
-void printCores() {
-    int num_cpu = sysconf(_SC_NPROCESSORS_ONLN);
-    printf("Number of cores: %d\n", num_cpu);
+// Applies pending session events (if any) to table and prints it
+void printUserInfoThird(SampleRing *userRing, SessionTable *table) {
+    drainSessions(userRing, table);
+
+    renderf("### Sessions/users ###\n");
+
+    for (int i = 0; i < table->count; i++)
+        renderf("%s\t %s (%s)\n", table->sessions[i].user, table->sessions[i].line, table->sessions[i].host);
+}
+
+// Prints the number of cores and the per-core breakdown of the last interval
+void printCores(const CpuSample *usage) {
+    int num_cpu = usage && usage->rows > 1 ? usage->rows - 1 : sysconf(_SC_NPROCESSORS_ONLN);
+    renderf("Number of cores: %d\n", num_cpu);
+
+    if (usage == NULL || usage->rows < 2)
+        return;
+
+    renderf(" core    busy%%  iowait%%  steal%%   irq%%\n");
+    for (int i = 1; i < usage->rows; i++)
+        renderf(" cpu%-3d %6.2f  %6.2f   %6.2f  %6.2f\n", usage->cpuId[i],
+               usage->busy[i], usage->iowait[i], usage->steal[i], usage->irq[i]);
+}
+
+// Opens /proc/stat for the lifetime of the collector
+int cpuInit(CpuCollector *cpu) {
+    return procOpen(&cpu->stat, "/proc/stat", cpu->buf, sizeof(cpu->buf));
+}
+
+void cpuFree(CpuCollector *cpu) {
+    procClose(&cpu->stat);
 }
 
-// Gathers CPU usage data and writes to pipe
-void storeCpuArr(int cpuFD[2]) {
-    unsigned long currCpuUsage[7];
-    FILE *fp = fopen("/proc/stat", "r");
+// Reads every cpu row of /proc/stat into a struct-of-arrays snapshot
+void storeCpuArr(CpuCollector *cpu, CpuSnapshot *snapshot) {
+    int rows = 0;
 
-    if (!fp) {
-        perror("Failed to open /proc/stat");
+    if (procRead(&cpu->stat) == -1) {
+        perror("Failed to read /proc/stat");
         exit(EXIT_FAILURE);
     }
 
-    if (fscanf(fp, "cpu %lu %lu %lu %lu %lu %lu %lu",
-               &currCpuUsage[0], &currCpuUsage[1], &currCpuUsage[2],
-               &currCpuUsage[3], &currCpuUsage[4], &currCpuUsage[5], &currCpuUsage[6]) != 7) {
-        fprintf(stderr, "Failed to parse /proc/stat\n");
-        fclose(fp);
-        exit(EXIT_FAILURE);
+    const char *p = cpu->stat.buf;
+    while (rows <= MAX_CPUS && p[0] == 'c' && p[1] == 'p' && p[2] == 'u') {
+        uint64_t f[8] = {0}, id = 0;
+
+        p += 3;
+        if (*p >= '0' && *p <= '9')
+            p = procScanU64(p, &id);
+        snapshot->cpuId[rows] = rows == 0 ? -1 : (int)id;
+
+        // Older kernels report fewer columns; missing ones stay zero
+        for (int k = 0; k < 8; k++) {
+            const char *next = procScanU64(p, &f[k]);
+            if (!next)
+                break;
+            p = next;
+        }
+
+        snapshot->user[rows] = f[0];
+        snapshot->nice[rows] = f[1];
+        snapshot->system[rows] = f[2];
+        snapshot->idle[rows] = f[3];
+        snapshot->iowait[rows] = f[4];
+        snapshot->irq[rows] = f[5];
+        snapshot->softirq[rows] = f[6];
+        snapshot->steal[rows] = f[7];
+        rows++;
+
+        p = procSkipLine(p);
     }
 
-    fclose(fp);
+    snapshot->timestampNs = monotonicNs();
 
-    if (write(cpuFD[1], &currCpuUsage, sizeof(currCpuUsage)) == -1) {
-        perror("Error writing CPU data to pipe");
-        kill(getpid(), SIGTERM);
-        kill(getppid(), SIGTERM);
+    if (rows == 0) {
+        fprintf(stderr, "Failed to parse /proc/stat\n");
         exit(EXIT_FAILURE);
     }
+    snapshot->rows = rows;
 }
 
-// Calculates CPU usage between two samples
-double calculateCpuUsage(unsigned long prev[7], unsigned long curr[7]) {
-    unsigned long idle_prev = prev[3] + prev[4];
-    unsigned long idle_cur = curr[3] + curr[4];
+// Lays prev out in curr's row order, matching rows by cpuId (both lists are in
+// ascending id order). A core that was offline in prev gets curr's own counters,
+// so it reads as a fresh row with zero usage instead of a bogus delta.
+static const CpuSnapshot *alignCpuRows(const CpuSnapshot *prev, const CpuSnapshot *curr, CpuSnapshot *aligned) {
+    int j = 0;
+
+    if (prev->rows == curr->rows && memcmp(prev->cpuId, curr->cpuId, sizeof(int) * curr->rows) == 0)
+        return prev;
+
+    memset(aligned, 0, sizeof(CpuSnapshot));
+    for (int i = 0; i < curr->rows; i++) {
+        while (j < prev->rows && prev->cpuId[j] < curr->cpuId[i])
+            j++;
+        const CpuSnapshot *from = j < prev->rows && prev->cpuId[j] == curr->cpuId[i] ? prev : curr;
+        int k = from == prev ? j : i;
+
+        aligned->user[i] = from->user[k];
+        aligned->nice[i] = from->nice[k];
+        aligned->system[i] = from->system[k];
+        aligned->idle[i] = from->idle[k];
+        aligned->iowait[i] = from->iowait[k];
+        aligned->irq[i] = from->irq[k];
+        aligned->softirq[i] = from->softirq[k];
+        aligned->steal[i] = from->steal[k];
+    }
+    aligned->timestampNs = prev->timestampNs;
+    aligned->rows = curr->rows;
+    return aligned;
+}
 
-    unsigned long total_prev = 0, total_cur = 0;
-    for (int i = 0; i < 7; i++) {
-        total_prev += prev[i];
-        total_cur += curr[i];
+// Calculates busy/iowait/steal/irq percentages for every row in one pass.
+// The loop body is branch-free and runs over padded rows so the compiler
+// can vectorise it; padding rows are zero and produce zero.
+void calculateCpuUsage(const CpuSnapshot *restrict prevSnapshot, const CpuSnapshot *restrict curr,
+                       CpuSample *restrict usage) {
+    CpuSnapshot aligned;
+    const CpuSnapshot *restrict prev = alignCpuRows(prevSnapshot, curr, &aligned);
+    int rows = curr->rows;
+    int padded = (rows + 7) & ~7;
+
+    for (int i = 0; i < padded; i++) {
+        float user = (int32_t)(curr->user[i] - prev->user[i]);
+        float nice = (int32_t)(curr->nice[i] - prev->nice[i]);
+        float system = (int32_t)(curr->system[i] - prev->system[i]);
+        float idle = (int32_t)(curr->idle[i] - prev->idle[i]);
+        float iowait = (int32_t)(curr->iowait[i] - prev->iowait[i]);
+        float irq = (int32_t)(curr->irq[i] - prev->irq[i]);
+        float softirq = (int32_t)(curr->softirq[i] - prev->softirq[i]);
+        float steal = (int32_t)(curr->steal[i] - prev->steal[i]);
+
+        float total = user + nice + system + idle + iowait + irq + softirq + steal;
+        float scale = 100.0f / (total + (float)(total == 0.0f));
+
+        usage->busy[i] = (total - idle - iowait) * scale;
+        usage->iowait[i] = iowait * scale;
+        usage->steal[i] = steal * scale;
+        usage->irq[i] = (irq + softirq) * scale;
     }
 
-    double total_diff = total_cur - total_prev;
-    double idle_diff = idle_cur - idle_prev;
+    memcpy(usage->cpuId, curr->cpuId, sizeof(int) * rows);
+    usage->rows = rows;
+    usage->intervalNs = curr->timestampNs - prev->timestampNs;
+}
+
+// Takes a baseline on tick 0, then pushes the usage since the previous tick on every tick
+void storeCpuSamples(SampleClock *clock, SampleRing *cpuRing) {
+    collectorRun("cpu", clock, cpuRing);
+}
+
+static int cpuCollectorInit(void *state) {
+    return cpuInit(state);
+}
+
+static int cpuCollectorSample(void *state, void *out) {
+    storeCpuArr(state, out);
+    return 0;
+}
+
+static void cpuCollectorDiff(void *state, const void *prev, const void *curr, void *out) {
+    CpuSample *sample = out;
+
+    (void)state;
+    calculateCpuUsage(prev, curr, sample);
+    sample->header.timestampNs = ((const CpuSnapshot *)curr)->timestampNs;
+}
 
-    return ((total_diff - idle_diff) / total_diff) * 100.0;
+static void cpuCollectorTeardown(void *state) {
+    cpuFree(state);
 }
 
-// Prints a graphical representation of CPU usage
-void setCpuGraphics(int sequential, char cpuArr[][200], float curUsage, float *prevUsage, int index) {
-    int barCount = 3 + (index == 0 ? (int)curUsage : (int)(curUsage - *prevUsage));
+const CollectorOps cpuCollector = {
+    .name = "cpu", .stateSize = sizeof(CpuCollector), .snapshotSize = sizeof(CpuSnapshot), .sampleSize = sizeof(CpuSample),
+    .latencyPhase = LAT_COLLECT_CPU, .init = cpuCollectorInit, .sample = cpuCollectorSample,
+    .diff = cpuCollectorDiff, .teardown = cpuCollectorTeardown,
+};
 
-    if (barCount < 3) barCount = 3;
+// Prints a graphical representation of CPU usage for the visible window
+void setCpuGraphics(const History *history) {
+    unsigned long first = history->count > (unsigned long)history->window ? history->count - history->window : 0;
 
-    char line[200] = "         ";
-    for (int i = 0; i < barCount; i++) strcat(line, "|");
+    for (unsigned long j = first; j < history->count; j++) {
+        const HistorySample *entry = historyAt(history, j);
+        int barCount = 3 + (int)entry->cpuDelta;
 
-    char percent[50];
-    snprintf(percent, sizeof(percent), " %.2f%%", curUsage);
-    strcat(line, percent);
+        if (barCount < 3) barCount = 3;
+        if (barCount > 150) barCount = 150;
 
-    strcpy(cpuArr[index], line);
+        char line[200] = "         ";
+        for (int i = 0; i < barCount; i++) strcat(line, "|");
 
-    for (int i = 0; i <= index; i++)
-        printf("%s\n", cpuArr[i]);
+        char percent[50];
+        snprintf(percent, sizeof(percent), " %.2f%%", entry->cpuBusy);
+        strcat(line, percent);
 
-    *prevUsage = curUsage;
+        renderf("%s\n", line);
+    }
 }
 
 // Displays system information at the end
 void printSystemInfoLast() {
     struct utsname sys;
-    FILE *fp = fopen("/proc/uptime", "r");
+    static char buf[64];
+    static ProcFile uptimeFile = { .fd = -1 };
+    uint64_t whole = 0;
 
-    if (!fp) {
+    if ((uptimeFile.fd == -1 && procOpen(&uptimeFile, "/proc/uptime", buf, sizeof(buf)) == -1) ||
+        procRead(&uptimeFile) == -1 || !procScanU64(uptimeFile.buf, &whole)) {
         perror("Unable to read /proc/uptime");
         return;
     }
 
-    double uptime;
-    fscanf(fp, "%lf", &uptime);
-    fclose(fp);
+    double uptime = whole;
 
     int days = uptime / (24 * 3600);
     uptime -= days * 24 * 3600;
@@ -263,17 +746,19 @@ void printSystemInfoLast() {
     }
 }
 
-// Calculates the total virtual memory used
-double calculateVirtUsed() {
-    struct sysinfo info;
-    sysinfo(&info);
-
-    double used = (info.totalram - info.freeram + info.totalswap - info.freeswap) / (1024.0 * 1024 * 1024);
-    return used;
-}
-
 // Reserves blank space in terminal output for overwrite/updating
 void reserve_space(int samples) {
     for (int i = 0; i < samples + 1; i++)
         printf("\n");
 }
+
+// Pops samples until the one taken for tick (or a later one) arrives; returns -1 if the ring closed first
+int popSample(SampleRing *ring, void *sample, uint32_t tick) {
+    const SampleHeader *header = sample;
+
+    while (ringPop(ring, sample) == 0) {
+        if (header->tick >= tick)
+            return 0;
+    }
+    return -1;
+}
@@ -27,37 +27,163 @@
 #include <getopt.h>
 #include <ctype.h>
 #include <signal.h>
-
+#include "sample_ring.h"
+#include "scheduler.h"
+#include "procfs.h"
+#include "frame.h"
+#include "latency.h"
+#include "collector.h"
+
+// Binary samples pushed by the collector children through their SampleRing.
+// Formatting into text happens only in the parent when a frame is rendered.
+typedef struct {
+    SampleHeader header;
+    double physUsedGb, physTotalGb;     // used = MemTotal - MemAvailable: page cache is not "used"
+    double virtUsedGb, virtTotalGb;
+    int detailed;                       // breakdown below is filled (0 for replayed samples)
+    double availGb, buffersGb, cachedGb, dirtyGb, writebackGb;
+    double slabGb, anonGb, swapCachedGb, hugeTotalGb, hugeFreeGb;
+} MemSample;
+
+#define MEMINFO_BUFSIZE 8192
+
+// State of the mem collector: /proc/meminfo kept open between samples
+typedef struct {
+    ProcFile meminfo;
+    char buf[MEMINFO_BUFSIZE];
+} MemCollector;
+
+#define MAX_CPUS 512
+#define PROC_STAT_BUFSIZE (128 * 1024)   // room for every cpu row of a 512-core /proc/stat
+#define CPU_ROWS (MAX_CPUS + 8)   // aggregate row + cores, padded to a multiple of 8
+
+// Struct-of-arrays copy of every "cpu"/"cpuN" row of /proc/stat.
+// Row 0 is the aggregate line, rows 1..rows-1 are the online cores.
+// Counters are kept modulo 2^32 so deltas stay exact and vectorise as int32.
+typedef struct {
+    uint64_t timestampNs;
+    int rows;
+    int cpuId[CPU_ROWS];
+    uint32_t user[CPU_ROWS], nice[CPU_ROWS], system[CPU_ROWS], idle[CPU_ROWS];
+    uint32_t iowait[CPU_ROWS], irq[CPU_ROWS], softirq[CPU_ROWS], steal[CPU_ROWS];
+} CpuSnapshot;
+
+// State of the cpu collector: /proc/stat kept open between snapshots
+typedef struct {
+    ProcFile stat;
+    char buf[PROC_STAT_BUFSIZE];
+} CpuCollector;
+
+// Per-row percentages between two snapshots, laid out like CpuSnapshot
+typedef struct {
+    SampleHeader header;
+    uint64_t intervalNs;    // measured time between the two snapshots
+    int rows;
+    int cpuId[CPU_ROWS];
+    float busy[CPU_ROWS], iowait[CPU_ROWS], steal[CPU_ROWS], irq[CPU_ROWS];
+} CpuSample;
+
+#define SESSION_ADD 0
+#define SESSION_REMOVE 1
+#define SESSION_RESET 2     // forget every session; the full table follows as adds
+
+// A session that appeared in or left utmp
+typedef struct {
+    int event;              // SESSION_ADD, SESSION_REMOVE or SESSION_RESET
+    char user[UT_NAMESIZE + 1];
+    char line[UT_LINESIZE + 1];
+    char host[UT_HOSTSIZE + 1];
+} SessionSample;
+
+#define HISTORY_WINDOW 60   // iterations kept for rendering, however long the run
+
+// Compact numeric record of one rendered iteration
+typedef struct {
+    uint64_t timestampNs;
+    unsigned long iteration;
+    int hasMem, hasCpu;
+    float physUsedGb, physTotalGb, virtUsedGb, virtTotalGb;
+    float graphVirtGb, graphDiffGb;   // figure the memory graphics show and its change
+    float cpuBusy, cpuDelta;          // CPU bar figure and its change
+} HistorySample;
+
+// Bounded ring of the most recent iterations; memory stays constant for unbounded runs
+typedef struct {
+    int window;               // rows shown (and kept)
+    unsigned long count;      // iterations pushed so far
+    double prevVirtGb;
+    float prevCpuBusy;
+    HistorySample items[HISTORY_WINDOW];
+} History;
+
+#define GRAPHICS_FLAT_GB 0.01       // memory change memoryGraphics draws as flat ("o"/"@")
+#define ADAPTIVE_FAST_NS 50000000ull    // --adaptive default fast interval
+#define ADAPTIVE_CPU_POINTS 5.0         // --adaptive default CPU busy change, percentage points
+
+// --adaptive: the sampling interval drops to fastNs when memory or CPU moved between
+// two samples, then doubles back toward slowNs with every flat sample
+typedef struct {
+    uint64_t slowNs, fastNs;
+    uint64_t intervalNs;                // interval until the next tick
+    double cpuPoints, memGb;            // change thresholds
+    double prevVirtGb, prevCpuBusy;    // NAN until the first sample
+    uint64_t bursts;                    // times a change switched to the fast rate
+} AdaptiveRate;
+
+#define MAX_SESSIONS 128
+
+// Current sessions, kept up to date from the collector's add/remove events
+typedef struct {
+    int count;
+    SessionSample sessions[MAX_SESSIONS];
+} SessionTable;
 
 // Function prototypes
-void GetInfoTop(int samples, int tdelay, int sequential, int iteration);
+void GetInfoTop(int samples, uint64_t intervalNs, int sequential, int iteration);
+
+
+void storeMemArr(SampleClock *clock, SampleRing *memRing);
+int memInit(MemCollector *mem);
+void sampleMem(MemCollector *mem, MemSample *sample);
+void memFree(MemCollector *mem);
+void printMemBreakdown(const MemSample *sample);
+void formatMemArr(const HistorySample *entry, int graphics, char *line, size_t size);
 
+void fcnForPrintMemoryArr(int sequential, const History *history, int graphics);
+void memoryGraphics(double virtual_used_gb, double difference, int first, char *line, size_t size);
 
-// void storeMemArr(int samples, int memFD[2]);
-void storeMemArr(int samples, int memFD[2],int tdelay);
+int parseAdaptive(const char *text, AdaptiveRate *rate);
+void adaptiveInit(AdaptiveRate *rate, uint64_t slowNs);
+uint64_t adaptiveUpdate(AdaptiveRate *rate, const MemSample *mem, const CpuSample *cpu);
 
-void fcnForPrintMemoryArr(int sequential, int samples, char memArr[][1024], int iteration,int memFD[2]);
-void memoryGraphics(double virtual_used_gb, double* prev_used_gb, char memArr[][1024], int iteration);
+void historyInit(History *history, int samples);
+void historyPush(History *history, const MemSample *mem, const CpuSample *cpu, double graphVirtGb);
+const HistorySample *historyAt(const History *history, unsigned long iteration);
 
 
-void storeUserInfoThird(int userFD[2],int ucountFD[2]);
-void printUserInfoThird(int userFD[2]);
+int sampleUsers(SessionTable *table);
+int sessionWatchOpen(void);
+int sessionWatchChanged(int watchFd);
+void storeUserInfoThird(SampleClock *clock, SampleRing *userRing);
+void drainSessions(SampleRing *userRing, SessionTable *table);
+void printUserInfoThird(SampleRing *userRing, SessionTable *table);
 
 
 
-void printCores();
+void printCores(const CpuSample *usage);
 
-void storeCpuArr(int cpuFD[2]);
-void printCpuUsageAndGraphics(int cpuPFD[2], int cpuCFD[2], int sequential, int i,int graphics);
-double calculateCpuUsage(unsigned long prevCpuUsage[7], unsigned long currCpuUsage[7]);
-// double calculateCpuUsage(int cpuPFD[2],int cpuCFD[2]);
-void setCpuGraphics(int sequential,char cpuArr[][200],float curCpuUsage,float *prevCpuUsage,int sampleIndex);
+int cpuInit(CpuCollector *cpu);
+void storeCpuArr(CpuCollector *cpu, CpuSnapshot *snapshot);
+void cpuFree(CpuCollector *cpu);
+void storeCpuSamples(SampleClock *clock, SampleRing *cpuRing);
+void calculateCpuUsage(const CpuSnapshot *prev, const CpuSnapshot *curr, CpuSample *usage);
+void setCpuGraphics(const History *history);
 
 
 
 void printSystemInfoLast();
-double calculateVirtUsed();
 
 void reserve_space(int samples);
+int popSample(SampleRing *ring, void *sample, uint32_t tick);
 
 #endif // STATS_FUNCTIONS_H
\ No newline at end of file